@@ -0,0 +1,228 @@
+/*
+ * File:    icollective_overlap.cpp
+ *
+ * Purpose: Benchmarks communication/computation overlap for nonblocking
+ * collectives (MPI_Iallreduce, MPI_Ibcast, MPI_Ibarrier).
+ *
+ * Scenario:
+ * 1. Each rank calibrates a compute kernel (iterations per microsecond).
+ * 2. For every operation and message size we measure the pure collective
+ *    time t_comm (start + immediate wait).
+ * 3. We then start the collective, run the kernel for t_comp = k * t_comm,
+ *    and only then wait. The total is t_ovl.
+ * 4. Overlap % = (t_comm + t_comp - t_ovl) / min(t_comm, t_comp) * 100.
+ *    100% means the collective finished entirely in the background.
+ *    0% means it only progressed inside MPI_Wait.
+ * 5. Each case is run twice: once with the kernel untouched, once with
+ *    periodic MPI_Test calls that give the library a chance to progress.
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Number of MPI_Test calls spread across the kernel in "test" mode.
+const int TEST_CALLS = 32;
+
+// Repetitions per measurement (we report the average of the slowest rank).
+const int REPS = 10;
+
+// A volatile sink prevents the compiler from removing the kernel.
+volatile double g_sink = 0.0;
+
+// The compute kernel: a dependent chain of multiply-adds.
+void compute(long iters) {
+  double x = 1.0;
+  for (long i = 0; i < iters; i++) {
+    x = x * 1.0000001 + 0.0000001;
+  }
+  g_sink = x;
+}
+
+// Run the kernel for 'iters' iterations. If 'req' is not null, split the
+// work into TEST_CALLS chunks and call MPI_Test between them.
+void compute_with_test(long iters, MPI_Request* req) {
+  if (req == nullptr) {
+    compute(iters);
+    return;
+  }
+  long chunk = std::max(1L, iters / TEST_CALLS);
+  int flag = 0;
+  for (long done = 0; done < iters; done += chunk) {
+    compute(std::min(chunk, iters - done));
+    if (!flag) {
+      MPI_Test(req, &flag, MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+// Calibrate how many kernel iterations fit in one microsecond.
+double calibrate() {
+  long iters = 1000;
+  double elapsed = 0.0;
+  // Grow the iteration count until a run takes at least 50 ms.
+  while (true) {
+    double t0 = MPI_Wtime();
+    compute(iters);
+    elapsed = MPI_Wtime() - t0;
+    if (elapsed > 0.05) break;
+    iters *= 2;
+  }
+  return iters / (elapsed * 1e6);
+}
+
+enum Op { OP_IALLREDUCE, OP_IBCAST, OP_IBARRIER };
+const char* OP_NAMES[] = {"Iallreduce", "Ibcast", "Ibarrier"};
+
+// Start one nonblocking collective on the given buffers.
+void start_op(Op op, std::vector<double>& send, std::vector<double>& recv,
+              MPI_Request* req) {
+  int count = (int)send.size();
+  switch (op) {
+    case OP_IALLREDUCE:
+      MPI_Iallreduce(send.data(), recv.data(), count, MPI_DOUBLE, MPI_SUM,
+                     MPI_COMM_WORLD, req);
+      break;
+    case OP_IBCAST:
+      MPI_Ibcast(send.data(), count, MPI_DOUBLE, 0, MPI_COMM_WORLD, req);
+      break;
+    case OP_IBARRIER:
+      MPI_Ibarrier(MPI_COMM_WORLD, req);
+      break;
+  }
+}
+
+// Average (over REPS) of the slowest rank's time for one configuration.
+// comp_iters == 0 measures the pure collective.
+double measure(Op op, std::vector<double>& send, std::vector<double>& recv,
+               long comp_iters, bool use_test) {
+  double total = 0.0;
+  for (int r = 0; r < REPS; r++) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+
+    MPI_Request req;
+    start_op(op, send, recv, &req);
+    if (comp_iters > 0) {
+      compute_with_test(comp_iters, use_test ? &req : nullptr);
+    }
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
+
+    double local = MPI_Wtime() - t0;
+    double slowest = 0.0;
+    MPI_Allreduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    total += slowest;
+  }
+  return total / REPS;
+}
+
+// Time of the kernel alone (slowest rank), so t_comp is measured, not assumed.
+double measure_compute(long comp_iters) {
+  double t0 = MPI_Wtime();
+  compute(comp_iters);
+  double local = MPI_Wtime() - t0;
+  double slowest = 0.0;
+  MPI_Allreduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return slowest;
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // 1. Calibrate the kernel
+  // Every rank calibrates locally; we then agree on the slowest rate so that
+  // a given iteration count takes at least the requested time everywhere.
+  double local_rate = calibrate();
+  double iters_per_us = 0.0;
+  MPI_Allreduce(&local_rate, &iters_per_us, 1, MPI_DOUBLE, MPI_MIN,
+                MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    printf("[Rank 0] Ranks: %d, kernel rate: %.1f iterations/us\n", size,
+           iters_per_us);
+    printf("%-11s %10s %6s %11s %11s %12s %12s\n", "Operation", "Bytes",
+           "k", "t_comm(us)", "t_comp(us)", "Overlap(%)", "w/Test(%)");
+  }
+
+  // 2. Message sizes (in doubles). Ibarrier has no payload, so one row.
+  const int sizes[] = {128, 8192, 131072, 1048576};
+  // Compute length as a multiple of the pure communication time.
+  const double factors[] = {0.5, 1.0, 2.0, 4.0};
+
+  for (int o = OP_IALLREDUCE; o <= OP_IBARRIER; o++) {
+    Op op = (Op)o;
+    for (int count : sizes) {
+      if (op == OP_IBARRIER && count != sizes[0]) break;
+
+      std::vector<double> send(count, rank + 1.0);
+      std::vector<double> recv(count);
+
+      // Warm up connections and internal buffers.
+      measure(op, send, recv, 0, false);
+
+      // 3. Pure communication time
+      double t_comm = measure(op, send, recv, 0, false);
+
+      for (double k : factors) {
+        long iters = (long)(k * t_comm * 1e6 * iters_per_us);
+        if (iters < 1) iters = 1;
+        double t_comp = measure_compute(iters);
+
+        // 4. Overlapped time, without and with MPI_Test progression
+        double t_plain = measure(op, send, recv, iters, false);
+        double t_test = measure(op, send, recv, iters, true);
+
+        double denom = std::min(t_comm, t_comp);
+        double ovl_plain = (t_comm + t_comp - t_plain) / denom * 100.0;
+        double ovl_test = (t_comm + t_comp - t_test) / denom * 100.0;
+        ovl_plain = std::max(0.0, std::min(100.0, ovl_plain));
+        ovl_test = std::max(0.0, std::min(100.0, ovl_test));
+
+        if (rank == 0) {
+          long bytes = (op == OP_IBARRIER) ? 0L : (long)count * sizeof(double);
+          printf("%-11s %10ld %6.1f %11.1f %11.1f %12.1f %12.1f\n",
+                 OP_NAMES[op], bytes, k, t_comm * 1e6, t_comp * 1e6,
+                 ovl_plain, ovl_test);
+        }
+      }
+    }
+  }
+
+  if (rank == 0) {
+    printf("--------------------------------\n");
+    printf("Low 'Overlap' but high 'w/Test' means the library only progresses\n");
+    printf("collectives inside MPI calls (no asynchronous progress thread).\n");
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 icollective_overlap.cpp -o icollective_overlap.bin
+ *
+ * 2. Run:
+ * mpirun -np 4 ./icollective_overlap.bin
+ *
+ * 3. Run on the cluster (see week2/hosts):
+ * mpirun --hostfile hosts \
+ *        --mca btl_tcp_if_include 10.140.0.0/16 \
+ *        ~/icollective_overlap.bin
+ *
+ * Tip: with MPICH, compare against MPIR_CVAR_ASYNC_PROGRESS=1 to see what a
+ * dedicated progress thread buys you.
+ * ============================================================
+ */
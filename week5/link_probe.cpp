@@ -0,0 +1,328 @@
+/*
+ * File:    link_probe.cpp
+ *
+ * Purpose: All-pairs link probe for the cluster.
+ * mpi_cluster_test.cpp tells us WHERE each rank runs; this program tells us
+ * how good the link between every pair of ranks is.
+ *
+ * Scenario:
+ * 1. Rank pairs are listed in round-robin ("circle") tournament order and
+ *    packed into steps so that every HOST takes part in at most one
+ *    ping-pong per step. With several ranks per host, the pairs of one
+ *    circle round would otherwise share a NIC (or the memory bus); here no
+ *    NIC carries two measurements at the same time (contention-free).
+ * 2. Each pair runs a small-message ping-pong (latency) and a large-message
+ *    ping-pong (bandwidth).
+ * 3. Rank 0 collects the matrices, groups the results by host pair,
+ *    flags outlier links, and writes a cost matrix file.
+ *
+ * Cost matrix file format (plain text, one token per field):
+ *   # comment lines start with '#'
+ *   ranks <P>
+ *   host <rank> <hostname>          (P lines)
+ *   latency_us                      (followed by P rows of P numbers)
+ *   bandwidth_MBps                  (followed by P rows of P numbers)
+ * Diagonal entries are 0.
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+const int LAT_BYTES = 8;               // Small message for latency
+const int LAT_REPS = 1000;
+const int BW_BYTES = 4 * 1024 * 1024;  // Large message for bandwidth
+const int BW_REPS = 10;
+const int PROBE_TAG = 0;
+
+// Outlier thresholds relative to the median of links of the same class
+// (intra-node links are compared with intra-node links, etc).
+const double LAT_OUTLIER_FACTOR = 2.0;  // latency > 2x median
+const double BW_OUTLIER_FACTOR = 0.5;   // bandwidth < 0.5x median
+
+// Circle-method tournament: partner of 'rank' in round 'round'.
+// 'n' is the number of players rounded up to an even number.
+// Returns -1 if the rank sits this round out (odd number of ranks).
+int round_robin_partner(int rank, int round, int n, int size) {
+  int partner;
+  if (rank == n - 1) {
+    partner = round;
+  } else if (rank == round) {
+    partner = n - 1;
+  } else {
+    partner = ((2 * round - rank) % (n - 1) + (n - 1)) % (n - 1);
+  }
+  return (partner >= size) ? -1 : partner;
+}
+
+// Measurement steps for ranks living on hosts 'host_of'. Pairs are taken
+// in circle-method order and put into the first step where neither host is
+// busy yet, so each host is in at most one measurement per step.
+std::vector<std::vector<std::pair<int, int>>> build_schedule(
+    const std::vector<int>& host_of, int num_hosts) {
+  int size = (int)host_of.size();
+  int n = (size % 2 == 0) ? size : size + 1;
+  std::vector<std::vector<std::pair<int, int>>> steps;
+  std::vector<std::vector<char>> busy;  // busy[step][host]
+  for (int round = 0; round < n - 1; round++) {
+    for (int r = 0; r < size; r++) {
+      int p = round_robin_partner(r, round, n, size);
+      if (p <= r) continue;  // Each pair once; -1 = sits out
+      int a = host_of[r], b = host_of[p];
+      size_t s = 0;
+      while (s < steps.size() && (busy[s][a] || busy[s][b])) s++;
+      if (s == steps.size()) {
+        steps.emplace_back();
+        busy.emplace_back(num_hosts, 0);
+      }
+      steps[s].push_back(std::make_pair(r, p));
+      busy[s][a] = busy[s][b] = 1;
+    }
+  }
+  return steps;
+}
+
+// Ping-pong with 'partner'. The lower rank initiates and times.
+// Returns the average round-trip time in seconds (on the initiator only).
+double ping_pong(int rank, int partner, std::vector<char>& buf, int bytes,
+                 int reps) {
+  bool initiator = rank < partner;
+
+  // One untimed round trip to set up the connection.
+  if (initiator) {
+    MPI_Send(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD);
+    MPI_Recv(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD,
+             MPI_STATUS_IGNORE);
+  } else {
+    MPI_Recv(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD,
+             MPI_STATUS_IGNORE);
+    MPI_Send(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD);
+  }
+
+  double t0 = MPI_Wtime();
+  for (int i = 0; i < reps; i++) {
+    if (initiator) {
+      MPI_Send(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD);
+      MPI_Recv(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD,
+               MPI_STATUS_IGNORE);
+    } else {
+      MPI_Recv(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD,
+               MPI_STATUS_IGNORE);
+      MPI_Send(buf.data(), bytes, MPI_CHAR, partner, PROBE_TAG, MPI_COMM_WORLD);
+    }
+  }
+  return (MPI_Wtime() - t0) / reps;
+}
+
+double median(std::vector<double> v) {
+  if (v.empty()) return 0.0;
+  std::sort(v.begin(), v.end());
+  size_t m = v.size() / 2;
+  return (v.size() % 2) ? v[m] : 0.5 * (v[m - 1] + v[m]);
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const char* out_path = (argc > 1) ? argv[1] : "link_costs.txt";
+
+  if (size < 2) {
+    if (rank == 0) {
+      printf("Error: Run with at least 2 processes.\n");
+    }
+    MPI_Finalize();
+    return 0;
+  }
+
+  // 1. Who runs where?
+  char name[MPI_MAX_PROCESSOR_NAME] = {0};
+  int name_len;
+  MPI_Get_processor_name(name, &name_len);
+  std::vector<char> all_names(size * MPI_MAX_PROCESSOR_NAME);
+  MPI_Allgather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, all_names.data(),
+                MPI_MAX_PROCESSOR_NAME, MPI_CHAR, MPI_COMM_WORLD);
+
+  // Every rank derives the same host ids, and therefore the same schedule.
+  std::map<std::string, int> host_ids;
+  std::vector<int> host_of(size);
+  for (int i = 0; i < size; i++) {
+    std::string h(&all_names[i * MPI_MAX_PROCESSOR_NAME]);
+    auto it = host_ids.insert(std::make_pair(h, (int)host_ids.size())).first;
+    host_of[i] = it->second;
+  }
+
+  // 2. Contention-free pairwise schedule
+  // My row of the cost matrix (filled only for partners where I initiate,
+  // the other half is mirrored on rank 0).
+  std::vector<double> my_lat(size, 0.0), my_bw(size, 0.0);
+  std::vector<char> buf(BW_BYTES, 'x');
+
+  std::vector<std::vector<std::pair<int, int>>> steps =
+      build_schedule(host_of, (int)host_ids.size());
+  if (rank == 0) {
+    printf("[Rank 0] %d ranks on %d hosts: %d pairs in %d steps "
+           "(one measurement per host per step)\n",
+           size, (int)host_ids.size(), size * (size - 1) / 2,
+           (int)steps.size());
+  }
+  for (const auto& step : steps) {
+    int partner = -1;
+    for (const auto& pr : step) {
+      if (pr.first == rank) partner = pr.second;
+      if (pr.second == rank) partner = pr.first;
+    }
+
+    if (partner >= 0) {
+      double lat_rtt = ping_pong(rank, partner, buf, LAT_BYTES, LAT_REPS);
+      double bw_rtt = ping_pong(rank, partner, buf, BW_BYTES, BW_REPS);
+      if (rank < partner) {
+        my_lat[partner] = lat_rtt / 2.0 * 1e6;              // one-way, us
+        my_bw[partner] = 2.0 * BW_BYTES / bw_rtt / 1e6;     // MB/s
+      }
+    }
+
+    // Keep steps separated so measurements never overlap.
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  // 3. Collect the matrices on Rank 0
+  std::vector<double> lat, bw;
+  if (rank == 0) {
+    lat.resize(size * size);
+    bw.resize(size * size);
+  }
+  MPI_Gather(my_lat.data(), size, MPI_DOUBLE, lat.data(), size, MPI_DOUBLE, 0,
+             MPI_COMM_WORLD);
+  MPI_Gather(my_bw.data(), size, MPI_DOUBLE, bw.data(), size, MPI_DOUBLE, 0,
+             MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    std::vector<std::string> hosts(size);
+    for (int i = 0; i < size; i++) {
+      hosts[i] = std::string(&all_names[i * MPI_MAX_PROCESSOR_NAME]);
+    }
+
+    // Mirror the upper triangle (links are measured in both directions).
+    for (int i = 0; i < size; i++) {
+      for (int j = i + 1; j < size; j++) {
+        lat[j * size + i] = lat[i * size + j];
+        bw[j * size + i] = bw[i * size + j];
+      }
+    }
+
+    // 4. Group by host pair
+    std::map<std::pair<std::string, std::string>, std::vector<int>> groups;
+    std::vector<double> intra_lat, intra_bw, inter_lat, inter_bw;
+    for (int i = 0; i < size; i++) {
+      for (int j = i + 1; j < size; j++) {
+        std::pair<std::string, std::string> key(std::min(hosts[i], hosts[j]),
+                                                std::max(hosts[i], hosts[j]));
+        groups[key].push_back(i * size + j);
+        bool intra = hosts[i] == hosts[j];
+        (intra ? intra_lat : inter_lat).push_back(lat[i * size + j]);
+        (intra ? intra_bw : inter_bw).push_back(bw[i * size + j]);
+      }
+    }
+
+    printf("[Rank 0] Link summary by host pair:\n");
+    printf("  %-20s %-20s %6s %14s %14s\n", "Host A", "Host B", "Links",
+           "Latency(us)", "BW(MB/s)");
+    for (auto& g : groups) {
+      double sum_lat = 0.0, sum_bw = 0.0;
+      for (int idx : g.second) {
+        sum_lat += lat[idx];
+        sum_bw += bw[idx];
+      }
+      int links = (int)g.second.size();
+      printf("  %-20s %-20s %6d %14.2f %14.1f\n", g.first.first.c_str(),
+             g.first.second.c_str(), links, sum_lat / links, sum_bw / links);
+    }
+
+    // 5. Flag outliers against the median of their class
+    double med_intra_lat = median(intra_lat), med_intra_bw = median(intra_bw);
+    double med_inter_lat = median(inter_lat), med_inter_bw = median(inter_bw);
+    int outliers = 0;
+    printf("[Rank 0] Outlier links (latency > %.1fx or bandwidth < %.1fx of "
+           "class median):\n", LAT_OUTLIER_FACTOR, BW_OUTLIER_FACTOR);
+    for (int i = 0; i < size; i++) {
+      for (int j = i + 1; j < size; j++) {
+        bool intra = hosts[i] == hosts[j];
+        double ref_lat = intra ? med_intra_lat : med_inter_lat;
+        double ref_bw = intra ? med_intra_bw : med_inter_bw;
+        double l = lat[i * size + j], b = bw[i * size + j];
+        if (l > LAT_OUTLIER_FACTOR * ref_lat || b < BW_OUTLIER_FACTOR * ref_bw) {
+          printf("  SLOW LINK: rank %d (%s) <-> rank %d (%s): %.2f us, "
+                 "%.1f MB/s (median %.2f us, %.1f MB/s)\n", i, hosts[i].c_str(),
+                 j, hosts[j].c_str(), l, b, ref_lat, ref_bw);
+          outliers++;
+        }
+      }
+    }
+    if (outliers == 0) {
+      printf("  None.\n");
+    }
+
+    // 6. Write the cost matrix
+    FILE* f = fopen(out_path, "w");
+    if (f == nullptr) {
+      printf("Error: Cannot open %s for writing.\n", out_path);
+    } else {
+      fprintf(f, "# link_probe cost matrix: one-way latency (%d B) and\n",
+              LAT_BYTES);
+      fprintf(f, "# ping-pong bandwidth (%d B) for every rank pair\n",
+              BW_BYTES);
+      fprintf(f, "ranks %d\n", size);
+      for (int i = 0; i < size; i++) {
+        fprintf(f, "host %d %s\n", i, hosts[i].c_str());
+      }
+      fprintf(f, "latency_us\n");
+      for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+          fprintf(f, "%.3f%c", lat[i * size + j], j == size - 1 ? '\n' : ' ');
+        }
+      }
+      fprintf(f, "bandwidth_MBps\n");
+      for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+          fprintf(f, "%.1f%c", bw[i * size + j], j == size - 1 ? '\n' : ' ');
+        }
+      }
+      fclose(f);
+      printf("[Rank 0] Cost matrix written to %s\n", out_path);
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 link_probe.cpp -o ~/link_probe.bin
+ * scp ~/link_probe.bin cc@192.5.86.160:~/
+ *
+ * 2. Run on the cluster (writes link_costs.txt on Rank 0's node):
+ * mpirun --hostfile hosts \
+ *        --mca btl_tcp_if_include 10.140.0.0/16 \
+ *        --mca oob_tcp_if_include 10.140.0.0/16 \
+ *        ~/link_probe.bin ~/link_costs.txt
+ *
+ * 3. Run locally:
+ * mpirun -np 4 ./link_probe.bin
+ * ============================================================
+ */
@@ -0,0 +1,321 @@
+/*
+ * File:    rank_reorder.cpp
+ *
+ * Purpose: Communication-graph-driven rank placement.
+ * 'mpirun --hostfile hosts' fills nodes in rank order (ranks 0,1 on the
+ * first host, 2,3 on the second, ...) without knowing who talks to whom.
+ * If rank 0 mostly talks to rank 2, every one of those bytes crosses the
+ * network. This program fixes that.
+ *
+ * Scenario:
+ * 1. Obtain a weighted communication graph (bytes sent from i to j), either
+ *    - loaded from a file (lines: "<src> <dst> <bytes>"), or
+ *    - recorded by running a sample exchange and counting bytes per peer.
+ * 2. Hand the graph to MPI via MPI_Dist_graph_create_adjacent(reorder = 1)
+ *    and report whether the library chose a different rank order.
+ * 3. Run our own mapping heuristic on Rank 0:
+ *    greedy node filling (heaviest-talking ranks first) followed by
+ *    pairwise swap refinement between nodes.
+ * 4. Report inter-node byte volume before/after and write an Open MPI
+ *    rankfile that launches every rank on the node chosen for it.
+ *
+ * Options:
+ *   -g <file>   Load the communication graph instead of recording it
+ *   -n <K>      Ranks per node (default: detected from hostnames). Use this
+ *               to emulate several nodes when running on a single machine.
+ *   -o <file>   Rankfile to write (default: rankfile.txt)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+const int SAMPLE_TAG = 0;
+
+// Bytes sent by each rank to each destination (one row of the graph).
+std::vector<long> g_sent_bytes;
+
+// Send wrapper that records traffic into g_sent_bytes.
+void traced_send(const void* buf, int count, MPI_Datatype type, int dest,
+                 int tag, MPI_Comm comm) {
+  int type_size;
+  MPI_Type_size(type, &type_size);
+  g_sent_bytes[dest] += (long)count * type_size;
+  MPI_Send(buf, count, type, dest, tag, comm);
+}
+
+// Sample workload to record: every rank exchanges a large buffer with its
+// "twin" half a communicator away and a small one with its ring neighbor.
+// Fill-in-order placement puts twins on different nodes, which is the worst
+// case for this pattern.
+void run_sample_exchange(int rank, int size) {
+  const int BIG = 1 << 20, SMALL = 1 << 10;
+  std::vector<int> send_buf(BIG, rank), recv_buf(BIG);
+
+  int twin = (rank + size / 2) % size;
+  int right = (rank + 1) % size, left = (rank - 1 + size) % size;
+
+  MPI_Request req;
+  if (twin != rank) {
+    MPI_Irecv(recv_buf.data(), BIG, MPI_INT, twin, SAMPLE_TAG, MPI_COMM_WORLD,
+              &req);
+    traced_send(send_buf.data(), BIG, MPI_INT, twin, SAMPLE_TAG,
+                MPI_COMM_WORLD);
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
+  }
+  if (right != rank) {
+    MPI_Irecv(recv_buf.data(), SMALL, MPI_INT, left, SAMPLE_TAG,
+              MPI_COMM_WORLD, &req);
+    traced_send(send_buf.data(), SMALL, MPI_INT, right, SAMPLE_TAG,
+                MPI_COMM_WORLD);
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
+  }
+}
+
+// Load "<src> <dst> <bytes>" lines into a dense size x size matrix.
+bool load_graph(const char* path, int size, std::vector<long>& graph) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) return false;
+  int src, dst;
+  long bytes;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%d %d %ld", &src, &dst, &bytes) != 3) continue;
+    if (src < 0 || src >= size || dst < 0 || dst >= size) continue;
+    graph[src * size + dst] += bytes;
+  }
+  fclose(f);
+  return true;
+}
+
+// Total bytes whose source and destination are on different nodes.
+long inter_node_bytes(const std::vector<long>& graph,
+                      const std::vector<int>& node_of, int size) {
+  long total = 0;
+  for (int i = 0; i < size; i++) {
+    for (int j = 0; j < size; j++) {
+      if (node_of[i] != node_of[j]) total += graph[i * size + j];
+    }
+  }
+  return total;
+}
+
+// Greedy graph mapping + swap refinement.
+// Returns node_of[rank] for 'num_nodes' nodes holding 'per_node' ranks each.
+std::vector<int> map_ranks(const std::vector<long>& graph, int size,
+                           int num_nodes, int per_node) {
+  // Symmetric weight: traffic in either direction counts.
+  std::vector<long> w(size * size);
+  std::vector<long> total(size, 0);
+  for (int i = 0; i < size; i++) {
+    for (int j = 0; j < size; j++) {
+      w[i * size + j] = graph[i * size + j] + graph[j * size + i];
+      total[i] += w[i * size + j];
+    }
+  }
+
+  // 1. Greedy fill: seed each node with the heaviest unplaced rank, then keep
+  //    adding the unplaced rank with the strongest connection to the node.
+  std::vector<int> node_of(size, -1);
+  std::vector<long> affinity(size);
+  for (int node = 0; node < num_nodes; node++) {
+    std::fill(affinity.begin(), affinity.end(), 0);
+    for (int slot = 0; slot < per_node; slot++) {
+      int best = -1;
+      for (int r = 0; r < size; r++) {
+        if (node_of[r] != -1) continue;
+        if (best == -1 || affinity[r] > affinity[best] ||
+            (affinity[r] == affinity[best] && slot == 0 &&
+             total[r] > total[best])) {
+          best = r;
+        }
+      }
+      if (best == -1) break;
+      node_of[best] = node;
+      for (int r = 0; r < size; r++) affinity[r] += w[best * size + r];
+    }
+  }
+
+  // 2. Refinement: swap two ranks on different nodes whenever it lowers the
+  //    cut. Repeat until no swap helps (bounded number of passes).
+  for (int pass = 0; pass < 10; pass++) {
+    bool improved = false;
+    for (int a = 0; a < size; a++) {
+      for (int b = a + 1; b < size; b++) {
+        int na = node_of[a], nb = node_of[b];
+        if (na == nb) continue;
+        long gain = 0;
+        for (int r = 0; r < size; r++) {
+          if (r == a || r == b) continue;
+          if (node_of[r] == nb) gain += w[a * size + r] - w[b * size + r];
+          if (node_of[r] == na) gain += w[b * size + r] - w[a * size + r];
+        }
+        if (gain > 0) {
+          std::swap(node_of[a], node_of[b]);
+          improved = true;
+        }
+      }
+    }
+    if (!improved) break;
+  }
+  return node_of;
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const char* graph_path = nullptr;
+  const char* rankfile_path = "rankfile.txt";
+  int per_node = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-g") == 0) graph_path = argv[i + 1];
+    if (strcmp(argv[i], "-n") == 0) per_node = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-o") == 0) rankfile_path = argv[i + 1];
+  }
+
+  // 1. Current placement (hostname of every rank)
+  char name[MPI_MAX_PROCESSOR_NAME] = {0};
+  int name_len;
+  MPI_Get_processor_name(name, &name_len);
+  std::vector<char> all_names(size * MPI_MAX_PROCESSOR_NAME);
+  MPI_Allgather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, all_names.data(),
+                MPI_MAX_PROCESSOR_NAME, MPI_CHAR, MPI_COMM_WORLD);
+  std::vector<std::string> hosts(size);
+  for (int i = 0; i < size; i++) {
+    hosts[i] = std::string(&all_names[i * MPI_MAX_PROCESSOR_NAME]);
+  }
+
+  // Without -n, assume every host got the same number of slots as the first.
+  if (per_node <= 0) {
+    per_node = (int)std::count(hosts.begin(), hosts.end(), hosts[0]);
+  }
+  int num_nodes = (size + per_node - 1) / per_node;
+
+  // 2. Communication graph: load it or record it
+  std::vector<long> graph(size * size, 0);
+  if (graph_path != nullptr) {
+    int ok = 1;
+    if (rank == 0) ok = load_graph(graph_path, size, graph) ? 1 : 0;
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ok) {
+      if (rank == 0) printf("Error: Cannot read graph file %s\n", graph_path);
+      MPI_Finalize();
+      return 0;
+    }
+    MPI_Bcast(graph.data(), size * size, MPI_LONG, 0, MPI_COMM_WORLD);
+  } else {
+    g_sent_bytes.assign(size, 0);
+    run_sample_exchange(rank, size);
+    MPI_Allgather(g_sent_bytes.data(), size, MPI_LONG, graph.data(), size,
+                  MPI_LONG, MPI_COMM_WORLD);
+  }
+
+  // 3. Let MPI try: distributed graph topology with reorder = 1
+  // Each rank only describes its own edges (sources = who sends to me,
+  // destinations = who I send to), weighted by byte volume.
+  std::vector<int> sources, source_w, dests, dest_w;
+  for (int r = 0; r < size; r++) {
+    if (graph[r * size + rank] > 0) {
+      sources.push_back(r);
+      source_w.push_back((int)std::min(graph[r * size + rank], 2147483647L));
+    }
+    if (graph[rank * size + r] > 0) {
+      dests.push_back(r);
+      dest_w.push_back((int)std::min(graph[rank * size + r], 2147483647L));
+    }
+  }
+  MPI_Comm graph_comm;
+  MPI_Dist_graph_create_adjacent(
+      MPI_COMM_WORLD, (int)sources.size(), sources.data(), source_w.data(),
+      (int)dests.size(), dests.data(), dest_w.data(), MPI_INFO_NULL,
+      1,  // reorder: the library may renumber ranks
+      &graph_comm);
+
+  int graph_rank;
+  MPI_Comm_rank(graph_comm, &graph_rank);
+  std::vector<int> graph_ranks(size);
+  MPI_Gather(&graph_rank, 1, MPI_INT, graph_ranks.data(), 1, MPI_INT, 0,
+             MPI_COMM_WORLD);
+  MPI_Comm_free(&graph_comm);
+
+  // 4. Our own mapping heuristic and the report
+  if (rank == 0) {
+    std::vector<int> before(size);
+    for (int r = 0; r < size; r++) before[r] = r / per_node;
+
+    int moved_by_mpi = 0;
+    for (int r = 0; r < size; r++) {
+      if (graph_ranks[r] != r) moved_by_mpi++;
+    }
+    printf("[Rank 0] MPI_Dist_graph_create_adjacent(reorder=1) renumbered %d "
+           "of %d ranks.\n", moved_by_mpi, size);
+
+    std::vector<int> after = map_ranks(graph, size, num_nodes, per_node);
+
+    long total = 0;
+    for (long b : graph) total += b;
+    long cut_before = inter_node_bytes(graph, before, size);
+    long cut_after = inter_node_bytes(graph, after, size);
+
+    printf("[Rank 0] Nodes: %d x %d ranks. Total traffic: %ld bytes\n",
+           num_nodes, per_node, total);
+    printf("[Rank 0] Inter-node bytes (hostfile order): %ld (%.1f%%)\n",
+           cut_before, total ? 100.0 * cut_before / total : 0.0);
+    printf("[Rank 0] Inter-node bytes (reordered):      %ld (%.1f%%)\n",
+           cut_after, total ? 100.0 * cut_after / total : 0.0);
+
+    // 5. Emit the rankfile
+    // Node k keeps the hostname that hostfile order gave it (its first rank).
+    FILE* f = fopen(rankfile_path, "w");
+    if (f == nullptr) {
+      printf("Error: Cannot open %s for writing.\n", rankfile_path);
+    } else {
+      // Slots are counted per hostname, so emulated nodes that share one
+      // machine still get distinct slots.
+      std::map<std::string, int> next_slot;
+      for (int r = 0; r < size; r++) {
+        int node = after[r];
+        const std::string& host = hosts[std::min(node * per_node, size - 1)];
+        fprintf(f, "rank %d=%s slot=%d\n", r, host.c_str(), next_slot[host]++);
+        printf("  Rank %d -> node %d (%s)\n", r, node, host.c_str());
+      }
+      fclose(f);
+      printf("[Rank 0] Rankfile written to %s\n", rankfile_path);
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 rank_reorder.cpp -o rank_reorder.bin
+ *
+ * 2. Record the sample pattern, emulating 2 nodes of 2 ranks locally:
+ * mpirun -np 4 ./rank_reorder.bin -n 2
+ *
+ * 3. Use a graph file ("src dst bytes" per line) on the cluster:
+ * mpirun --hostfile hosts ~/rank_reorder.bin -g comm_graph.txt
+ *
+ * 4. Relaunch the real application with the computed placement:
+ * mpirun --rankfile rankfile.txt -np 4 ./app.bin
+ * ============================================================
+ */
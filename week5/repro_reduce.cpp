@@ -0,0 +1,294 @@
+/*
+ * File:    repro_reduce.cpp
+ *
+ * Purpose: Reproducible floating-point reduction as a custom MPI_Op.
+ * Floating-point addition is not associative: (a + b) + c != a + (b + c).
+ * MPI_SUM on doubles therefore depends on how many ranks there are, how the
+ * data is split, and which reduction tree the library picks. This program
+ * shows the problem and fixes it with a binned (exact) accumulator.
+ *
+ * How the binned accumulator works:
+ * - Every double is m * 2^e with a 53-bit integer mantissa m.
+ * - The whole exponent range is cut into 32-bit wide "bins". A value is
+ *   added by splitting its (shifted) mantissa over at most 3 neighboring
+ *   bins, each one a 64-bit integer. Integer addition IS associative, so
+ *   the bins hold the exact sum no matter the order.
+ * - Carries are propagated ("normalized") often enough that the 64-bit bins
+ *   never overflow, which also makes the representation canonical.
+ * - Converting the canonical bins back to a double is deterministic, so the
+ *   final result is bitwise identical for every decomposition.
+ *
+ * Scenario:
+ * 1. The same global array of doubles (wide dynamic range) is reduced with
+ *    1, 2, ..., size ranks and with a shuffled local order.
+ * 2. MPI_SUM results differ in the last bits; the binned results do not.
+ * 3. Throughput of both methods is compared.
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Bins cover bit positions 0 .. NUM_BINS*32 above 2^-1074 (smallest subnormal).
+const int BIN_BITS = 32;
+const int NUM_BINS = 66;  // 66 * 32 = 2112 > 2098 bits of double range
+const int MIN_EXP = -1074;
+
+// Each add changes a bin by < 2^32, so 2^30 adds are always safe in int64.
+const long NORMALIZE_EVERY = 1L << 30;
+
+struct ReproAcc {
+  int64_t bin[NUM_BINS];
+  int64_t pos_inf, neg_inf, nan;  // Special values are just counted
+};
+
+void acc_init(ReproAcc& a) { memset(&a, 0, sizeof(a)); }
+
+// Propagate carries so every bin except the top one is in [0, 2^32).
+void acc_normalize(ReproAcc& a) {
+  for (int i = 0; i < NUM_BINS - 1; i++) {
+    int64_t carry = a.bin[i] >> BIN_BITS;  // Arithmetic shift (floor)
+    a.bin[i] -= carry * ((int64_t)1 << BIN_BITS);
+    a.bin[i + 1] += carry;
+  }
+}
+
+// Add one double exactly.
+inline void acc_add(ReproAcc& a, double x) {
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int exp_field = (int)((bits >> 52) & 0x7FF);
+  uint64_t mant = bits & 0xFFFFFFFFFFFFFULL;
+  bool neg = bits >> 63;
+
+  if (exp_field == 0x7FF) {
+    if (mant != 0) a.nan++;
+    else if (neg) a.neg_inf++;
+    else a.pos_inf++;
+    return;
+  }
+  // Normal numbers have an implicit leading 1; subnormals share exponent 1.
+  int pos;
+  if (exp_field == 0) {
+    pos = 0;
+  } else {
+    mant |= 1ULL << 52;
+    pos = exp_field - 1;  // (exp_field - 1075) - MIN_EXP
+  }
+  if (mant == 0) return;
+
+  int idx = pos / BIN_BITS;
+  unsigned __int128 shifted = (unsigned __int128)mant << (pos % BIN_BITS);
+  int64_t lo = (int64_t)(shifted & 0xFFFFFFFFu);
+  int64_t mid = (int64_t)((shifted >> 32) & 0xFFFFFFFFu);
+  int64_t hi = (int64_t)(shifted >> 64);
+  if (neg) {
+    lo = -lo;
+    mid = -mid;
+    hi = -hi;
+  }
+  a.bin[idx] += lo;
+  a.bin[idx + 1] += mid;
+  if (idx + 2 < NUM_BINS) a.bin[idx + 2] += hi;
+}
+
+// Exact local sum of an array.
+void acc_add_array(ReproAcc& a, const double* x, long n) {
+  for (long start = 0; start < n; start += NORMALIZE_EVERY) {
+    long end = std::min(n, start + NORMALIZE_EVERY);
+    for (long i = start; i < end; i++) acc_add(a, x[i]);
+    acc_normalize(a);
+  }
+}
+
+// Deterministic conversion of the (normalized) bins to a double.
+double acc_to_double(const ReproAcc& in) {
+  if (in.nan > 0 || (in.pos_inf > 0 && in.neg_inf > 0)) return NAN;
+  if (in.pos_inf > 0) return INFINITY;
+  if (in.neg_inf > 0) return -INFINITY;
+
+  ReproAcc a = in;
+  acc_normalize(a);
+
+  // Work on the magnitude: if negative, negate all bins and renormalize.
+  double sign = 1.0;
+  if (a.bin[NUM_BINS - 1] < 0) {
+    sign = -1.0;
+    for (int i = 0; i < NUM_BINS; i++) a.bin[i] = -a.bin[i];
+    acc_normalize(a);
+  }
+
+  int top = NUM_BINS - 1;
+  while (top > 0 && a.bin[top] == 0) top--;
+
+  // Three bins = 96 significant bits, more than enough for 53-bit rounding.
+  // Sum smallest first so the large term absorbs the rounding once.
+  double result = 0.0;
+  for (int i = std::max(0, top - 2); i <= top; i++) {
+    result += std::ldexp((double)a.bin[i], i * BIN_BITS + MIN_EXP);
+  }
+  return sign * result;
+}
+
+// The MPI_Op: element-wise exact merge of accumulators.
+void repro_sum_op(void* in, void* inout, int* len, MPI_Datatype*) {
+  ReproAcc* src = (ReproAcc*)in;
+  ReproAcc* dst = (ReproAcc*)inout;
+  for (int k = 0; k < *len; k++) {
+    for (int i = 0; i < NUM_BINS; i++) dst[k].bin[i] += src[k].bin[i];
+    dst[k].pos_inf += src[k].pos_inf;
+    dst[k].neg_inf += src[k].neg_inf;
+    dst[k].nan += src[k].nan;
+    acc_normalize(dst[k]);
+  }
+}
+
+// Global element i: mixed signs and magnitudes from 1e-10 to 1e10, so the
+// order of additions visibly matters for MPI_SUM.
+double global_value(long i) {
+  double mag = std::pow(10.0, (double)(i % 21) - 10.0);
+  return std::sin((double)i * 0.7) * mag;
+}
+
+// Deterministic shuffle (xorshift) of the local slice.
+void shuffle(std::vector<double>& v, uint64_t seed) {
+  uint64_t s = seed * 0x9E3779B97F4A7C15ULL + 1;
+  for (long i = (long)v.size() - 1; i > 0; i--) {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    std::swap(v[i], v[s % (uint64_t)(i + 1)]);
+  }
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const long N = (argc > 1) ? atol(argv[1]) : 4000000;
+
+  // 1. Register the datatype and the operation
+  // The accumulator travels as an opaque block of bytes. The op is
+  // commutative (integer addition), so MPI may use any reduction tree.
+  MPI_Datatype acc_type;
+  MPI_Type_contiguous(sizeof(ReproAcc), MPI_BYTE, &acc_type);
+  MPI_Type_commit(&acc_type);
+
+  MPI_Op repro_sum;
+  MPI_Op_create(repro_sum_op, 1, &repro_sum);
+
+  if (rank == 0) {
+    printf("[Rank 0] Summing %ld doubles with 1..%d ranks\n", N, size);
+    printf("%6s %8s %24s %24s\n", "Ranks", "Order", "MPI_SUM", "Binned");
+  }
+
+  // 2. Reduce the same global array with different decompositions
+  for (int p = 1; p <= size; p++) {
+    MPI_Comm sub;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &sub);
+
+    for (int shuffled = 0; shuffled <= 1; shuffled++) {
+      double native = 0.0, repro = 0.0;
+      if (sub != MPI_COMM_NULL) {
+        // Same block distribution logic as vector_multiply_irregular.cpp
+        long base = N / p, rem = N % p;
+        long my_count = base + (rank < rem ? 1 : 0);
+        long start = rank * base + std::min((long)rank, rem);
+
+        std::vector<double> local(my_count);
+        for (long i = 0; i < my_count; i++) local[i] = global_value(start + i);
+        if (shuffled) shuffle(local, rank + 1);
+
+        double local_sum = 0.0;
+        for (double x : local) local_sum += x;
+        MPI_Reduce(&local_sum, &native, 1, MPI_DOUBLE, MPI_SUM, 0, sub);
+
+        ReproAcc local_acc, global_acc;
+        acc_init(local_acc);
+        acc_add_array(local_acc, local.data(), my_count);
+        MPI_Reduce(&local_acc, &global_acc, 1, acc_type, repro_sum, 0, sub);
+        if (rank == 0) repro = acc_to_double(global_acc);
+      }
+      if (rank == 0) {
+        printf("%6d %8s %24.17e %24.17e\n", p, shuffled ? "shuffled" : "block",
+               native, repro);
+      }
+    }
+    if (sub != MPI_COMM_NULL) MPI_Comm_free(&sub);
+  }
+
+  // 3. Throughput: full communicator, local sum + Allreduce
+  long base = N / size, rem = N % size;
+  long my_count = base + (rank < rem ? 1 : 0);
+  long start = rank * base + std::min((long)rank, rem);
+  std::vector<double> local(my_count);
+  for (long i = 0; i < my_count; i++) local[i] = global_value(start + i);
+
+  const int REPS = 5;
+  double native = 0.0, repro = 0.0;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t0 = MPI_Wtime();
+  for (int r = 0; r < REPS; r++) {
+    double local_sum = 0.0;
+    for (double x : local) local_sum += x;
+    MPI_Allreduce(&local_sum, &native, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  }
+  double t_native = (MPI_Wtime() - t0) / REPS;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t0 = MPI_Wtime();
+  for (int r = 0; r < REPS; r++) {
+    ReproAcc local_acc, global_acc;
+    acc_init(local_acc);
+    acc_add_array(local_acc, local.data(), my_count);
+    MPI_Allreduce(&local_acc, &global_acc, 1, acc_type, repro_sum,
+                  MPI_COMM_WORLD);
+    repro = acc_to_double(global_acc);
+  }
+  double t_repro = (MPI_Wtime() - t0) / REPS;
+
+  if (rank == 0) {
+    printf("--------------------------------\n");
+    printf("[Rank 0] MPI_SUM: %8.3f ms  (%.1f Melem/s)\n", t_native * 1e3,
+           N / t_native / 1e6);
+    printf("[Rank 0] Binned:  %8.3f ms  (%.1f Melem/s), %.2fx slower\n",
+           t_repro * 1e3, N / t_repro / 1e6, t_repro / t_native);
+    printf("[Rank 0] Allreduce results: MPI_SUM %.17e, Binned %.17e\n", native,
+           repro);
+  }
+
+  MPI_Op_free(&repro_sum);
+  MPI_Type_free(&acc_type);
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 repro_reduce.cpp -o repro_reduce.bin
+ *
+ * 2. Run (optional argument: number of elements):
+ * mpirun -np 4 ./repro_reduce.bin 4000000
+ *
+ * Observation:
+ * The MPI_SUM column changes in the last digits from row to row.
+ * The Binned column is identical in every row, for any -np.
+ * ============================================================
+ */
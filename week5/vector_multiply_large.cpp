@@ -0,0 +1,281 @@
+/*
+ * File:    vector_multiply_large.cpp
+ *
+ * Purpose: vector_multiply_irregular.cpp for more than 2^31 elements.
+ * Classic MPI signatures take 'int' counts and displacements, so
+ * MPI_Scatterv/MPI_Gatherv break as soon as one slice or one offset
+ * passes 2,147,483,647 elements. This version keeps N, send_counts and
+ * displs in 64 bits and picks one of three data paths:
+ *
+ * 1. MPI-4 "large count" collectives (MPI_Scatterv_c / MPI_Gatherv_c),
+ *    when the library provides them.
+ * 2. Plain MPI_Scatterv / MPI_Gatherv, when every count and displacement
+ *    still fits in an int (no reason to pay for anything fancier).
+ * 3. Fallback for MPI-3 libraries: each slice is described by ONE derived
+ *    datatype built from 2^30-element contiguous chunks plus a remainder
+ *    (the "BigMPI" trick), and the root moves it with Isend/Irecv.
+ *    Displacements become byte addresses (MPI_Aint), which are 64-bit.
+ *
+ * Before any data moves, the program self-checks the large datatype builder
+ * against MPI_Type_size_x for counts above 2^31 (this needs no memory), and
+ * after the gather it verifies every element.
+ *
+ * Options:
+ *   [N]   Number of elements, e.g. 20e9 (default 5e7)
+ *   -f    Force path 3 even when paths 1/2 are available (for testing)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <vector>
+
+// Largest chunk used inside the aggregated datatype (fits easily in an int).
+const long long CHUNK = 1LL << 30;
+
+const int DATA_TAG = 0;
+
+// Build a datatype describing 'count' consecutive elements of 'base',
+// where count may exceed INT_MAX. The caller must commit and free it.
+MPI_Datatype make_large_type(long long count, MPI_Datatype base) {
+  MPI_Datatype result;
+  long long chunks = count / CHUNK;
+  int remainder = (int)(count % CHUNK);
+
+  if (chunks == 0) {
+    MPI_Type_contiguous(remainder, base, &result);
+    return result;
+  }
+
+  // 'chunks' blocks of CHUNK elements each ...
+  MPI_Datatype chunk_type, blocks_type;
+  MPI_Type_contiguous((int)CHUNK, base, &chunk_type);
+  MPI_Type_contiguous((int)chunks, chunk_type, &blocks_type);
+
+  if (remainder == 0) {
+    MPI_Type_free(&chunk_type);
+    return blocks_type;
+  }
+
+  // ... followed by the remainder, placed with a 64-bit byte displacement.
+  MPI_Aint lb, extent;
+  MPI_Type_get_extent(base, &lb, &extent);
+  MPI_Datatype rem_type;
+  MPI_Type_contiguous(remainder, base, &rem_type);
+
+  int blocklens[2] = {1, 1};
+  MPI_Aint disps[2] = {0, (MPI_Aint)(chunks * CHUNK) * extent};
+  MPI_Datatype types[2] = {blocks_type, rem_type};
+  MPI_Type_create_struct(2, blocklens, disps, types, &result);
+
+  MPI_Type_free(&chunk_type);
+  MPI_Type_free(&blocks_type);
+  MPI_Type_free(&rem_type);
+  return result;
+}
+
+// Self-check: the aggregated type must describe exactly count elements.
+bool check_large_types() {
+  const long long counts[] = {0, 1, CHUNK - 1, CHUNK, INT_MAX,
+                              (long long)INT_MAX + 1, 3 * CHUNK + 12345,
+                              20000000000LL};
+  bool ok = true;
+  for (long long c : counts) {
+    MPI_Datatype t = make_large_type(c, MPI_INT);
+    MPI_Type_commit(&t);
+    MPI_Count bytes;
+    MPI_Type_size_x(t, &bytes);
+    if (bytes != (MPI_Count)(c * sizeof(int))) {
+      printf("  FAIL: count %lld -> %lld bytes\n", c, (long long)bytes);
+      ok = false;
+    }
+    MPI_Type_free(&t);
+  }
+  return ok;
+}
+
+enum Path { PATH_MPI4, PATH_INT, PATH_AGGREGATED };
+const char* PATH_NAMES[] = {"MPI-4 large-count (_c)", "MPI_Scatterv (int)",
+                            "Aggregated datatypes + Isend/Irecv"};
+
+// Move slices between root's 'global' and every rank's 'local'.
+// scatter == true: root -> ranks; otherwise ranks -> root.
+void move_slices(bool scatter, Path path, int* global, int* local,
+                 const std::vector<long long>& counts,
+                 const std::vector<long long>& displs, int rank, int size) {
+  long long my_count = counts[rank];
+
+#if MPI_VERSION >= 4
+  if (path == PATH_MPI4) {
+    std::vector<MPI_Count> c(counts.begin(), counts.end());
+    std::vector<MPI_Aint> d(displs.begin(), displs.end());
+    if (scatter) {
+      MPI_Scatterv_c(global, c.data(), d.data(), MPI_INT, local, my_count,
+                     MPI_INT, 0, MPI_COMM_WORLD);
+    } else {
+      MPI_Gatherv_c(local, my_count, MPI_INT, global, c.data(), d.data(),
+                    MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    return;
+  }
+#endif
+
+  if (path == PATH_INT) {
+    std::vector<int> c(counts.begin(), counts.end());
+    std::vector<int> d(displs.begin(), displs.end());
+    if (scatter) {
+      MPI_Scatterv(global, c.data(), d.data(), MPI_INT, local, (int)my_count,
+                   MPI_INT, 0, MPI_COMM_WORLD);
+    } else {
+      MPI_Gatherv(local, (int)my_count, MPI_INT, global, c.data(), d.data(),
+                  MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    return;
+  }
+
+  // PATH_AGGREGATED: one message of one (large) datatype per rank.
+  if (rank == 0) {
+    std::vector<MPI_Request> reqs;
+    for (int i = 1; i < size; i++) {
+      if (counts[i] == 0) continue;
+      MPI_Datatype t = make_large_type(counts[i], MPI_INT);
+      MPI_Type_commit(&t);
+      MPI_Request req;
+      if (scatter) {
+        MPI_Isend(global + displs[i], 1, t, i, DATA_TAG, MPI_COMM_WORLD, &req);
+      } else {
+        MPI_Irecv(global + displs[i], 1, t, i, DATA_TAG, MPI_COMM_WORLD, &req);
+      }
+      // Freeing a type is safe while requests that use it are pending.
+      MPI_Type_free(&t);
+      reqs.push_back(req);
+    }
+    // The root's own slice is a local copy.
+    if (scatter) {
+      memcpy(local, global + displs[0], my_count * sizeof(int));
+    } else {
+      memcpy(global + displs[0], local, my_count * sizeof(int));
+    }
+    MPI_Waitall((int)reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+  } else if (my_count > 0) {
+    MPI_Datatype t = make_large_type(my_count, MPI_INT);
+    MPI_Type_commit(&t);
+    if (scatter) {
+      MPI_Recv(local, 1, t, 0, DATA_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    } else {
+      MPI_Send(local, 1, t, 0, DATA_TAG, MPI_COMM_WORLD);
+    }
+    MPI_Type_free(&t);
+  }
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int world_rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  long long N = 50000000LL;
+  bool force_fallback = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-f") == 0) force_fallback = true;
+    else N = (long long)strtod(argv[i], nullptr);  // Accepts "20e9"
+  }
+
+  // 1. Self-check the datatype builder (no data needed)
+  if (world_rank == 0) {
+    bool ok = check_large_types();
+    printf("[Master] Large datatype self-check: %s\n", ok ? "PASS" : "FAIL");
+  }
+
+  // 2. Distribution logic, in 64 bits
+  // Same "%" logic as vector_multiply_irregular.cpp, but every rank computes
+  // the full plan locally so the aggregated path needs no extra messages.
+  std::vector<long long> send_counts(world_size), displs(world_size);
+  long long base_count = N / world_size;
+  long long remainder = N % world_size;
+  long long current_idx = 0;
+  bool fits_int = true;
+  for (int i = 0; i < world_size; i++) {
+    send_counts[i] = base_count + (i < remainder ? 1 : 0);
+    displs[i] = current_idx;
+    current_idx += send_counts[i];
+    if (send_counts[i] > INT_MAX || displs[i] > INT_MAX) fits_int = false;
+  }
+  long long my_count = send_counts[world_rank];
+
+  Path path = fits_int ? PATH_INT : PATH_AGGREGATED;
+#if MPI_VERSION >= 4
+  path = PATH_MPI4;
+#endif
+  if (force_fallback) path = PATH_AGGREGATED;
+
+  if (world_rank == 0) {
+    printf("[Master] N = %lld elements (%.2f GB), %d ranks, path: %s\n", N,
+           N * sizeof(int) / 1e9, world_size, PATH_NAMES[path]);
+  }
+
+  // 3. Data generation (Root only). Values stay small so that x2 fits.
+  std::vector<int> global_data;
+  if (world_rank == 0) {
+    global_data.resize(N);
+    for (long long i = 0; i < N; i++) global_data[i] = (int)(i % 1000003);
+  }
+  std::vector<int> local_data(my_count);
+
+  // 4. Scatter, compute, gather (timed)
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t0 = MPI_Wtime();
+  move_slices(true, path, global_data.data(), local_data.data(), send_counts,
+              displs, world_rank, world_size);
+  double t1 = MPI_Wtime();
+
+  for (long long i = 0; i < my_count; i++) {
+    local_data[i] *= 2;
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t2 = MPI_Wtime();
+
+  move_slices(false, path, global_data.data(), local_data.data(), send_counts,
+              displs, world_rank, world_size);
+  double t3 = MPI_Wtime();
+
+  // 5. Verification and throughput (Root only)
+  if (world_rank == 0) {
+    long long errors = 0;
+    for (long long i = 0; i < N; i++) {
+      if (global_data[i] != 2 * (int)(i % 1000003)) errors++;
+    }
+    double gb = N * sizeof(int) / 1e9;
+    printf("[Master] Verification: %lld mismatches out of %lld -> %s\n",
+           errors, N, errors == 0 ? "PASS" : "FAIL");
+    printf("[Master] Scatter: %8.3f s  %7.2f GB/s\n", t1 - t0,
+           gb / (t1 - t0));
+    printf("[Master] Compute: %8.3f s  %7.2f GB/s\n", t2 - t1,
+           gb / (t2 - t1));
+    printf("[Master] Gather:  %8.3f s  %7.2f GB/s\n", t3 - t2,
+           gb / (t3 - t2));
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/**
+ * To setup the system
+ * On Ubuntu: sudo apt install openmpi-bin libopenmpi-dev build-essential
+ * On MacOS: brew install open-mpi
+ * To compile: mpic++ -O2 vector_multiply_large.cpp -o vector_large.bin
+ * To run
+ * Small run:             mpirun -np 4 ./vector_large.bin
+ * Test the fallback:     mpirun -np 4 ./vector_large.bin 1e7 -f
+ * Tens of billions (needs ~4 bytes x N on Rank 0 plus each slice):
+ *   mpirun --hostfile hosts ./vector_large.bin 20e9
+ */
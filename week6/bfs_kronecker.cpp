@@ -0,0 +1,465 @@
+/*
+ * File:    bfs_kronecker.cpp
+ *
+ * Purpose: Level-synchronous distributed Breadth-First Search with
+ * direction optimization, measured in TEPS (traversed edges per second)
+ * on Graph500-style Kronecker graphs.
+ *
+ * Scenario:
+ * 1. Every rank generates its share of the edges of a Kronecker (R-MAT)
+ *    graph with 2^scale vertices and edgefactor * 2^scale edges. Each edge
+ *    has its own random stream, so the graph does not depend on -np.
+ * 2. 1D partitioning: vertices are split into contiguous ranges (whole
+ *    64-vertex words, with the usual remainder logic). Edges are shipped
+ *    to the owners of both endpoints with MPI_Alltoallv and stored as a
+ *    local CSR adjacency.
+ * 3. BFS, one level at a time. Each level runs in one of two directions:
+ *    - Top-down (sparse frontier): for every frontier vertex, send
+ *      (neighbor, parent) pairs to the neighbor's owner with MPI_Alltoallv.
+ *    - Bottom-up (dense frontier): the frontier is a bitmap, assembled
+ *      with MPI_Allgatherv. Every unvisited vertex scans its own neighbors
+ *      and stops at the first one in the frontier. No pairs are sent.
+ *    We switch with Beamer's heuristic: go bottom-up when the frontier's
+ *    edges exceed (unvisited edges / ALPHA), go back top-down when the
+ *    frontier shrinks below N / BETA vertices.
+ * 4. For several random roots we validate the parent tree and report the
+ *    harmonic-mean TEPS of top-down-only and direction-optimizing BFS.
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-09
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+const int EDGE_FACTOR = 16;
+const int NUM_ROOTS = 8;
+const double RMAT_A = 0.57, RMAT_B = 0.19, RMAT_C = 0.19;
+const double ALPHA = 14.0;  // Top-down -> bottom-up threshold
+const double BETA = 24.0;   // Bottom-up -> top-down threshold
+
+uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Graph500 scrambles vertex labels so that high-degree vertices do not all
+// land on Rank 0. Multiplying by an odd constant is a bijection mod 2^scale.
+int64_t scramble(int64_t v, int scale) {
+  uint64_t mask = (scale >= 64) ? ~0ULL : ((1ULL << scale) - 1);
+  return (int64_t)((((uint64_t)v * 0x9E3779B97F4A7C15ULL) & mask) ^
+                   (0x5DEECE66DULL & mask));
+}
+
+// One R-MAT edge: at every level pick a quadrant with probabilities A,B,C,D.
+void kronecker_edge(int64_t index, int scale, int64_t& u, int64_t& v) {
+  uint64_t state = mix64((uint64_t)index * 2654435761ULL + 12345);
+  u = 0;
+  v = 0;
+  for (int level = 0; level < scale; level++) {
+    state = mix64(state);
+    double r = (state >> 11) * (1.0 / 9007199254740992.0);
+    int ubit = (r >= RMAT_A + RMAT_B) ? 1 : 0;
+    int vbit = (r >= RMAT_A && r < RMAT_A + RMAT_B) ||
+               r >= RMAT_A + RMAT_B + RMAT_C;
+    u = (u << 1) | ubit;
+    v = (v << 1) | vbit;
+  }
+  u = scramble(u, scale);
+  v = scramble(v, scale);
+}
+
+// Vertices are split in whole 64-vertex words (with the usual remainder
+// logic over words), so every rank's part of a frontier bitmap is a whole
+// number of uint64_t words and MPI_Allgatherv can assemble it directly.
+struct Partition {
+  int64_t n, words, base, rem;
+  int size;
+  Partition(int64_t n_, int size_)
+      : n(n_), words((n_ + 63) / 64), base(words / size_),
+        rem(words % size_), size(size_) {}
+  int64_t first_word(int r) const {
+    return r * base + std::min((int64_t)r, rem);
+  }
+  int64_t word_count(int r) const { return base + (r < rem ? 1 : 0); }
+  int64_t first(int r) const { return first_word(r) * 64; }
+  int64_t count(int r) const {
+    return std::min(n, (first_word(r) + word_count(r)) * 64) - first(r);
+  }
+  int owner(int64_t v) const {
+    int64_t w = v >> 6;
+    int64_t cut = rem * (base + 1);
+    if (w < cut) return (int)(w / (base + 1));
+    return (int)(rem + (w - cut) / base);
+  }
+};
+
+// Exchange variable-size buckets of int64 values with MPI_Alltoallv.
+std::vector<int64_t> exchange_buckets(
+    const std::vector<std::vector<int64_t>>& out, MPI_Comm comm) {
+  int size = (int)out.size();
+  std::vector<int> send_counts(size), recv_counts(size);
+  std::vector<int> send_displs(size, 0), recv_displs(size, 0);
+  for (int r = 0; r < size; r++) send_counts[r] = (int)out[r].size();
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT,
+               comm);
+  for (int r = 1; r < size; r++) {
+    send_displs[r] = send_displs[r - 1] + send_counts[r - 1];
+    recv_displs[r] = recv_displs[r - 1] + recv_counts[r - 1];
+  }
+  std::vector<int64_t> send(send_displs[size - 1] + send_counts[size - 1]);
+  for (int r = 0; r < size; r++) {
+    std::copy(out[r].begin(), out[r].end(), send.begin() + send_displs[r]);
+  }
+  std::vector<int64_t> recv(recv_displs[size - 1] + recv_counts[size - 1]);
+  MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(),
+                MPI_INT64_T, recv.data(), recv_counts.data(),
+                recv_displs.data(), MPI_INT64_T, comm);
+  return recv;
+}
+
+struct LocalGraph {
+  int64_t first, count;
+  std::vector<int64_t> row_ptr;  // count + 1
+  std::vector<int64_t> adj;      // global neighbor ids
+};
+
+LocalGraph build_graph(int scale, const Partition& part, int rank,
+                       MPI_Comm comm) {
+  int64_t num_edges = (int64_t)EDGE_FACTOR << scale;
+  int64_t e_base = num_edges / part.size, e_rem = num_edges % part.size;
+  int64_t e_first = rank * e_base + std::min((int64_t)rank, e_rem);
+  int64_t e_count = e_base + (rank < e_rem ? 1 : 0);
+
+  // 1. Generate my edges and route both directions to the owners.
+  std::vector<std::vector<int64_t>> out(part.size);
+  for (int64_t e = e_first; e < e_first + e_count; e++) {
+    int64_t u, v;
+    kronecker_edge(e, scale, u, v);
+    if (u == v) continue;  // Self-loops do not matter for BFS
+    out[part.owner(u)].push_back(u);
+    out[part.owner(u)].push_back(v);
+    out[part.owner(v)].push_back(v);
+    out[part.owner(v)].push_back(u);
+  }
+  std::vector<int64_t> pairs = exchange_buckets(out, comm);
+
+  // 2. Counting sort into CSR.
+  LocalGraph g;
+  g.first = part.first(rank);
+  g.count = part.count(rank);
+  g.row_ptr.assign(g.count + 1, 0);
+  for (size_t i = 0; i < pairs.size(); i += 2) {
+    g.row_ptr[pairs[i] - g.first + 1]++;
+  }
+  for (int64_t i = 0; i < g.count; i++) g.row_ptr[i + 1] += g.row_ptr[i];
+  g.adj.resize(pairs.size() / 2);
+  std::vector<int64_t> fill(g.row_ptr.begin(), g.row_ptr.end() - 1);
+  for (size_t i = 0; i < pairs.size(); i += 2) {
+    g.adj[fill[pairs[i] - g.first]++] = pairs[i + 1];
+  }
+  return g;
+}
+
+struct BfsStats {
+  int levels = 0, bottom_up_levels = 0;
+};
+
+// Direction-optimizing BFS. parent[v - first] = parent id or -1.
+BfsStats bfs(const LocalGraph& g, const Partition& part, int64_t root,
+             bool allow_bottom_up, std::vector<int64_t>& parent,
+             MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  BfsStats stats;
+
+  parent.assign(g.count, -1);
+  std::vector<int64_t> frontier;  // Local vertex indices
+  if (part.owner(root) == rank) {
+    parent[root - g.first] = root;
+    frontier.push_back(root - g.first);
+  }
+
+  // Bitmaps: local words for my range, global words for everyone's.
+  std::vector<uint64_t> local_bits(part.word_count(rank));
+  std::vector<uint64_t> global_bits(part.words);
+  std::vector<int> word_counts(part.size), word_displs(part.size);
+  for (int r = 0; r < part.size; r++) {
+    word_counts[r] = (int)part.word_count(r);
+    word_displs[r] = (int)part.first_word(r);
+  }
+
+  int64_t local_unvisited_edges = (int64_t)g.adj.size();
+  bool bottom_up = false;
+  int64_t prev_frontier = 0;
+
+  while (true) {
+    // Global frontier size and edge counts decide the direction.
+    int64_t local[3] = {(int64_t)frontier.size(), 0, 0};
+    for (int64_t v : frontier) local[1] += g.row_ptr[v + 1] - g.row_ptr[v];
+    local_unvisited_edges -= local[1];
+    local[2] = local_unvisited_edges;
+    int64_t global[3];
+    MPI_Allreduce(local, global, 3, MPI_INT64_T, MPI_SUM, comm);
+    int64_t n_f = global[0], m_f = global[1], m_u = global[2];
+    if (n_f == 0) break;
+
+    if (allow_bottom_up) {
+      if (!bottom_up && m_f > m_u / ALPHA) {
+        bottom_up = true;
+      } else if (bottom_up && n_f < prev_frontier &&
+                 n_f < (int64_t)(part.n / BETA)) {
+        bottom_up = false;
+      }
+    }
+    prev_frontier = n_f;
+    stats.levels++;
+
+    std::vector<int64_t> next;
+    if (!bottom_up) {
+      // --- Top-down: push (neighbor, parent) pairs to the owners ---
+      std::vector<std::vector<int64_t>> out(part.size);
+      for (int64_t v : frontier) {
+        int64_t u = g.first + v;
+        for (int64_t p = g.row_ptr[v]; p < g.row_ptr[v + 1]; p++) {
+          int64_t w = g.adj[p];
+          int o = part.owner(w);
+          if (o == rank && parent[w - g.first] != -1) continue;  // Known
+          out[o].push_back(w);
+          out[o].push_back(u);
+        }
+      }
+      std::vector<int64_t> in = exchange_buckets(out, comm);
+      for (size_t i = 0; i < in.size(); i += 2) {
+        int64_t w = in[i] - g.first;
+        if (parent[w] == -1) {
+          parent[w] = in[i + 1];
+          next.push_back(w);
+        }
+      }
+    } else {
+      // --- Bottom-up: share the frontier as a bitmap, then pull ---
+      // N / 8 bytes in total, much less than the pairs a dense top-down
+      // level would send.
+      std::fill(local_bits.begin(), local_bits.end(), 0);
+      for (int64_t v : frontier) local_bits[v >> 6] |= 1ULL << (v & 63);
+      MPI_Allgatherv(local_bits.data(), (int)local_bits.size(), MPI_UINT64_T,
+                     global_bits.data(), word_counts.data(),
+                     word_displs.data(), MPI_UINT64_T, comm);
+      stats.bottom_up_levels++;
+
+      for (int64_t v = 0; v < g.count; v++) {
+        if (parent[v] != -1) continue;
+        for (int64_t p = g.row_ptr[v]; p < g.row_ptr[v + 1]; p++) {
+          int64_t w = g.adj[p];
+          if (global_bits[w >> 6] & (1ULL << (w & 63))) {
+            parent[v] = w;
+            next.push_back(v);
+            break;  // First parent found: stop scanning
+          }
+        }
+      }
+    }
+    frontier.swap(next);
+  }
+  return stats;
+}
+
+// Validate the parent tree the way Graph500 does:
+// - the root is its own parent, every other parent is a real neighbor;
+// - tree levels come from following parent pointers (root = level 0,
+//   level[v] = level[parent[v]] + 1); a vertex that never gets one sits on
+//   a parent cycle or hangs off an unvisited vertex;
+// - no graph edge spans more than one level, and no edge joins a visited
+//   and an unvisited vertex. Together with the tree this makes the levels
+//   shortest distances, i.e. the tree is a BFS tree.
+// Returns the number of undirected edges in the searched component.
+int64_t validate(const LocalGraph& g, const Partition& part, int64_t root,
+                 const std::vector<int64_t>& parent, int64_t& errors,
+                 MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  int64_t local_err = 0, degree_sum = 0;
+  for (int64_t v = 0; v < g.count; v++) {
+    if (parent[v] == -1) continue;
+    degree_sum += g.row_ptr[v + 1] - g.row_ptr[v];
+    int64_t id = g.first + v;
+    if (id == root) {
+      if (parent[v] != root) local_err++;
+      continue;
+    }
+    bool found = false;
+    for (int64_t p = g.row_ptr[v]; p < g.row_ptr[v + 1] && !found; p++) {
+      found = g.adj[p] == parent[v];
+    }
+    if (!found) local_err++;
+  }
+
+  // 1. Levels from the tree, one round per level: ask the owner of each
+  //    parent for its level until nothing changes.
+  std::vector<int64_t> level(g.count, -1);
+  if (part.owner(root) == rank) level[root - g.first] = 0;
+  while (true) {
+    std::vector<std::vector<int64_t>> ask(part.size);
+    for (int64_t v = 0; v < g.count; v++) {
+      if (parent[v] == -1 || level[v] != -1) continue;
+      ask[part.owner(parent[v])].push_back(parent[v]);
+      ask[part.owner(parent[v])].push_back(g.first + v);
+    }
+    std::vector<int64_t> in = exchange_buckets(ask, comm);
+    std::vector<std::vector<int64_t>> reply(part.size);
+    for (size_t i = 0; i < in.size(); i += 2) {
+      int64_t lp = level[in[i] - g.first];
+      if (lp < 0) continue;  // Parent not placed yet: ask again next round
+      reply[part.owner(in[i + 1])].push_back(in[i + 1]);
+      reply[part.owner(in[i + 1])].push_back(lp + 1);
+    }
+    in = exchange_buckets(reply, comm);
+    for (size_t i = 0; i < in.size(); i += 2) {
+      level[in[i] - g.first] = in[i + 1];
+    }
+
+    int64_t local[2] = {(int64_t)in.size() / 2, 0}, global[2];
+    for (int64_t v = 0; v < g.count; v++) {
+      if (parent[v] != -1 && level[v] == -1) local[1]++;
+    }
+    MPI_Allreduce(local, global, 2, MPI_INT64_T, MPI_SUM, comm);
+    if (global[1] == 0) break;
+    if (global[0] == 0) {  // No progress: cycles or dangling parents
+      local_err += local[1];
+      break;
+    }
+  }
+
+  // 2. Every edge (v, w): send level[v] to the owner of w and compare.
+  std::vector<std::vector<int64_t>> out(part.size);
+  for (int64_t v = 0; v < g.count; v++) {
+    for (int64_t p = g.row_ptr[v]; p < g.row_ptr[v + 1]; p++) {
+      out[part.owner(g.adj[p])].push_back(g.adj[p]);
+      out[part.owner(g.adj[p])].push_back(level[v]);
+    }
+  }
+  std::vector<int64_t> in = exchange_buckets(out, comm);
+  for (size_t i = 0; i < in.size(); i += 2) {
+    int64_t lw = level[in[i] - g.first], lv = in[i + 1];
+    if ((lw < 0) != (lv < 0)) {
+      local_err++;  // Visited vertex next to an unvisited one
+    } else if (lw >= 0 && (lw - lv > 1 || lv - lw > 1)) {
+      local_err++;  // Edge spans more than one level
+    }
+  }
+
+  int64_t total_degree = 0;
+  MPI_Allreduce(&local_err, &errors, 1, MPI_INT64_T, MPI_SUM, comm);
+  MPI_Allreduce(&degree_sum, &total_degree, 1, MPI_INT64_T, MPI_SUM, comm);
+  return total_degree / 2;
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int scale = (argc > 1) ? atoi(argv[1]) : 18;
+
+  // Every rank needs at least one 64-vertex word of the partition.
+  int64_t words = 0;
+  if (scale >= 1 && scale <= 40) words = (((int64_t)1 << scale) + 63) / 64;
+  if (words < size) {
+    if (rank == 0) {
+      printf("Error: scale must be in [1, 40] with 2^scale / 64 >= %d "
+             "processes.\n", size);
+    }
+    MPI_Finalize();
+    return 0;
+  }
+  Partition part((int64_t)1 << scale, size);
+
+  // 1. Generate and distribute the graph
+  double t0 = MPI_Wtime();
+  LocalGraph g = build_graph(scale, part, rank, MPI_COMM_WORLD);
+  double t_build = MPI_Wtime() - t0;
+  if (rank == 0) {
+    printf("[Rank 0] Kronecker graph: scale %d (%lld vertices), edgefactor "
+           "%d, built in %.2f s on %d ranks\n", scale, (long long)part.n,
+           EDGE_FACTOR, t_build, size);
+    printf("%6s %12s %14s %14s %8s %10s %8s\n", "Root#", "Edges",
+           "TopDown TEPS", "DirOpt TEPS", "Levels", "BottomUp", "Valid");
+  }
+
+  // 2. Pick roots with at least one neighbor (the same on every rank)
+  std::vector<int64_t> parent;
+  double inv_td = 0.0, inv_do = 0.0;
+  int done = 0;
+  for (uint64_t attempt = 0; done < NUM_ROOTS && attempt < 1000; attempt++) {
+    int64_t root = (int64_t)(mix64(attempt + 777) % (uint64_t)part.n);
+    int64_t deg = 0, my_deg = 0;
+    if (part.owner(root) == rank) {
+      int64_t v = root - g.first;
+      my_deg = g.row_ptr[v + 1] - g.row_ptr[v];
+    }
+    MPI_Allreduce(&my_deg, &deg, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (deg == 0) continue;
+
+    // 3. Top-down only, then direction-optimizing
+    double times[2];
+    BfsStats stats;
+    int64_t edges[2], errors[2];
+    for (int mode = 0; mode < 2; mode++) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      t0 = MPI_Wtime();
+      BfsStats s = bfs(g, part, root, mode == 1, parent, MPI_COMM_WORLD);
+      times[mode] = MPI_Wtime() - t0;
+      MPI_Allreduce(MPI_IN_PLACE, &times[mode], 1, MPI_DOUBLE, MPI_MAX,
+                    MPI_COMM_WORLD);
+      edges[mode] = validate(g, part, root, parent, errors[mode],
+                             MPI_COMM_WORLD);
+      if (mode == 1) stats = s;
+    }
+
+    bool valid = errors[0] == 0 && errors[1] == 0 && edges[0] == edges[1];
+    double teps_td = edges[0] / times[0], teps_do = edges[1] / times[1];
+    inv_td += 1.0 / teps_td;
+    inv_do += 1.0 / teps_do;
+    done++;
+    if (rank == 0) {
+      printf("%6d %12lld %14.3e %14.3e %8d %10d %8s\n", done,
+             (long long)edges[1], teps_td, teps_do, stats.levels,
+             stats.bottom_up_levels, valid ? "yes" : "NO");
+    }
+  }
+
+  if (rank == 0 && done > 0) {
+    printf("--------------------------------\n");
+    printf("[Rank 0] Harmonic mean TEPS: top-down %.3e, direction-optimizing "
+           "%.3e (%.2fx)\n", done / inv_td, done / inv_do, inv_td / inv_do);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O3 bfs_kronecker.cpp -o bfs_kronecker.bin
+ *
+ * 2. Run (argument: scale, i.e. log2 of the number of vertices):
+ * mpirun -np 4 ./bfs_kronecker.bin 18
+ *
+ * 3. Larger graphs on the cluster:
+ * mpirun --hostfile hosts ~/bfs_kronecker.bin 24
+ * ============================================================
+ */
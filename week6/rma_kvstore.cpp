@@ -0,0 +1,399 @@
+/*
+ * File:    rma_kvstore.cpp
+ *
+ * Purpose: A distributed in-memory key-value store built on one-sided MPI.
+ * Every rank owns one shard of a hash table, exposed in an RMA window.
+ * Clients read and write remote shards directly -- the owner's CPU is never
+ * involved (no MPI_Recv loop, no server thread).
+ *
+ * Layout:
+ * - key -> owner rank = hash(key) % size, home slot = another hash bit range.
+ * - Each shard is an open-addressing table of {key, value} int64 pairs with
+ *   linear probing. Key 0 means "empty". A key lives within MAX_PROBE slots
+ *   of its home slot (the table has MAX_PROBE spare slots at the end, so a
+ *   probe sequence never wraps around).
+ *
+ * Operations (all inside one MPI_Win_lock_all passive-target epoch):
+ * - GET:  fetch the whole MAX_PROBE window with ONE MPI_Get and search it
+ *         locally. In mixed read/write phases we use MPI_Get_accumulate with
+ *         MPI_NO_OP instead, the atomic flavor of MPI_Get (a plain Get racing
+ *         with an Accumulate on the same location is undefined in MPI).
+ * - PUT:  claim a slot with MPI_Compare_and_swap(0 -> key); if the slot holds
+ *         another key, try the next one. Then store the value atomically
+ *         with MPI_Accumulate(MPI_REPLACE).
+ * - Batching: clients group operations by owner, issue them all, and call
+ *   MPI_Win_flush once per owner, so a batch costs a few round trips
+ *   instead of one per key.
+ *
+ * Benchmark (YCSB-style): zipfian key popularity (theta = 0.99) over the
+ * loaded records, workloads A (50% read / 50% update), B (95/5), C (100%
+ * read), repeated for 1, 2, 4, ... ranks.
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-09
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const int MAX_PROBE = 32;                 // Slots searched per key
+const long RECORDS_PER_RANK = 100000;     // Loaded records per rank
+const long OPS_PER_RANK = 200000;         // Operations per workload per rank
+const int BATCH = 256;                    // Operations per client batch
+const double ZIPF_THETA = 0.99;
+
+// SplitMix64: a fast, well-mixed 64-bit hash.
+uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+class KVStore {
+ public:
+  // Collective over 'comm'. 'slots' is the number of home slots per shard.
+  KVStore(MPI_Comm comm, long slots) : comm_(comm), slots_(slots) {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &size_);
+    long total = 2 * (slots_ + MAX_PROBE);
+    MPI_Win_allocate(total * sizeof(int64_t), sizeof(int64_t), MPI_INFO_NULL,
+                     comm_, &table_, &win_);
+    memset(table_, 0, total * sizeof(int64_t));
+    MPI_Barrier(comm_);
+    MPI_Win_lock_all(0, win_);
+    MPI_Win_sync(win_);
+  }
+
+  ~KVStore() {
+    MPI_Win_unlock_all(win_);
+    MPI_Win_free(&win_);
+  }
+
+  int owner(int64_t key) const { return (int)(mix64(key) % size_); }
+  long home(int64_t key) const { return (long)((mix64(key) >> 20) % slots_); }
+
+  // Insert or overwrite. Returns the number of keys that found no free slot.
+  long put_batch(const std::vector<int64_t>& keys,
+                 const std::vector<int64_t>& values) {
+    size_t n = keys.size();
+    std::vector<int> probe(n, 0);
+    std::vector<int64_t> seen(n, 0);
+    std::vector<size_t> pending(n);
+    for (size_t i = 0; i < n; i++) pending[i] = i;
+    std::vector<size_t> placed;
+    long failed = 0;
+    const int64_t empty = 0;
+
+    // Round by round: one CAS per pending key, one flush per owner.
+    while (!pending.empty()) {
+      sort_by_owner(pending, keys);
+      for (size_t i : pending) {
+        MPI_Compare_and_swap(&keys[i], &empty, &seen[i], MPI_INT64_T,
+                             owner(keys[i]), 2 * (home(keys[i]) + probe[i]),
+                             win_);
+      }
+      flush_owners(pending, keys);
+
+      std::vector<size_t> next;
+      for (size_t i : pending) {
+        if (seen[i] == 0 || seen[i] == keys[i]) {
+          placed.push_back(i);  // Slot claimed (or key already there)
+        } else if (++probe[i] >= MAX_PROBE) {
+          failed++;             // Neighborhood full
+        } else {
+          next.push_back(i);
+        }
+      }
+      pending.swap(next);
+    }
+
+    // Store the values of every placed key.
+    sort_by_owner(placed, keys);
+    for (size_t i : placed) {
+      MPI_Accumulate(&values[i], 1, MPI_INT64_T, owner(keys[i]),
+                     2 * (home(keys[i]) + probe[i]) + 1, 1, MPI_INT64_T,
+                     MPI_REPLACE, win_);
+    }
+    flush_owners(placed, keys);
+    return failed;
+  }
+
+  // Look up keys. found[i] = 0 if the key is absent.
+  void get_batch(const std::vector<int64_t>& keys, std::vector<int64_t>& out,
+                 std::vector<char>& found, bool atomic) {
+    size_t n = keys.size();
+    const int W = 2 * MAX_PROBE;
+    std::vector<int64_t> windows(n * W);
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) order[i] = i;
+    sort_by_owner(order, keys);
+
+    for (size_t i : order) {
+      int target = owner(keys[i]);
+      MPI_Aint disp = 2 * home(keys[i]);
+      if (atomic) {
+        MPI_Get_accumulate(nullptr, 0, MPI_INT64_T, &windows[i * W], W,
+                           MPI_INT64_T, target, disp, W, MPI_INT64_T,
+                           MPI_NO_OP, win_);
+      } else {
+        MPI_Get(&windows[i * W], W, MPI_INT64_T, target, disp, W,
+                MPI_INT64_T, win_);
+      }
+    }
+    flush_owners(order, keys);
+
+    out.assign(n, 0);
+    found.assign(n, 0);
+    for (size_t i = 0; i < n; i++) {
+      for (int p = 0; p < MAX_PROBE; p++) {
+        int64_t k = windows[i * W + 2 * p];
+        if (k == keys[i]) {
+          out[i] = windows[i * W + 2 * p + 1];
+          found[i] = 1;
+          break;
+        }
+        if (k == 0) break;  // Empty slot ends the probe sequence
+      }
+    }
+  }
+
+ private:
+  void sort_by_owner(std::vector<size_t>& idx,
+                     const std::vector<int64_t>& keys) const {
+    std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+      return owner(keys[a]) < owner(keys[b]);
+    });
+  }
+
+  // One flush per distinct owner ('idx' is sorted by owner).
+  void flush_owners(const std::vector<size_t>& idx,
+                    const std::vector<int64_t>& keys) {
+    int last = -1;
+    for (size_t i : idx) {
+      int o = owner(keys[i]);
+      if (o != last) {
+        if (last >= 0) MPI_Win_flush(last, win_);
+        last = o;
+      }
+    }
+    if (last >= 0) MPI_Win_flush(last, win_);
+  }
+
+  MPI_Comm comm_;
+  int rank_, size_;
+  long slots_;
+  int64_t* table_;
+  MPI_Win win_;
+};
+
+// YCSB's zipfian generator (Gray et al., "Quickly Generating Billion-Record
+// Synthetic Databases"). Item 0 is the most popular.
+class Zipfian {
+ public:
+  Zipfian(long items, double theta) : n_(items), theta_(theta) {
+    zetan_ = 0.0;
+    for (long i = 1; i <= n_; i++) zetan_ += 1.0 / std::pow((double)i, theta_);
+    double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1.0 - std::pow(2.0 / n_, 1.0 - theta_)) / (1.0 - zeta2 / zetan_);
+  }
+
+  long next(double u) const {
+    double uz = u * zetan_;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+    long v = (long)(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(v, n_ - 1);
+  }
+
+ private:
+  long n_;
+  double theta_, zetan_, alpha_, eta_;
+};
+
+// Per-rank uniform random numbers in [0, 1).
+struct Rng {
+  uint64_t state;
+  double next() {
+    state = mix64(state);
+    return (state >> 11) * (1.0 / 9007199254740992.0);
+  }
+};
+
+// Record i is stored under key i + 1 (0 is reserved for "empty").
+int64_t record_key(long i) { return (int64_t)i + 1; }
+int64_t initial_value(int64_t key) { return key * 7; }
+
+double percentile(std::vector<double>& v, double p) {
+  if (v.empty()) return 0.0;
+  std::sort(v.begin(), v.end());
+  size_t idx = std::min(v.size() - 1, (size_t)(p * v.size()));
+  return v[idx];
+}
+
+void run_config(MPI_Comm comm, const Zipfian& zipf, long records) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  // A load factor of about 1/4 keeps linear-probing clusters well below
+  // MAX_PROBE even on the most loaded shard.
+  KVStore store(comm, 4 * records / size + 1024);
+
+  // 1. Load phase: rank r inserts records r, r + size, r + 2 * size, ...
+  long failed = 0;
+  std::vector<int64_t> keys, values;
+  for (long i = rank; i < records; i += size) {
+    keys.push_back(record_key(i));
+    values.push_back(initial_value(keys.back()));
+    if ((long)keys.size() == BATCH || i + size >= records) {
+      failed += store.put_batch(keys, values);
+      keys.clear();
+      values.clear();
+    }
+  }
+  MPI_Barrier(comm);
+
+  // 2. Verify: read back my records with plain MPI_Get (no writers now)
+  long wrong = 0;
+  std::vector<int64_t> out;
+  std::vector<char> found;
+  for (long i = rank; i < records; i += size) {
+    keys.push_back(record_key(i));
+    if ((long)keys.size() == BATCH || i + size >= records) {
+      store.get_batch(keys, out, found, false);
+      for (size_t k = 0; k < keys.size(); k++) {
+        if (!found[k] || out[k] != initial_value(keys[k])) wrong++;
+      }
+      keys.clear();
+    }
+  }
+  long total_failed = 0, total_wrong = 0;
+  MPI_Reduce(&failed, &total_failed, 1, MPI_LONG, MPI_SUM, 0, comm);
+  MPI_Reduce(&wrong, &total_wrong, 1, MPI_LONG, MPI_SUM, 0, comm);
+  if (rank == 0) {
+    printf("[Rank 0] %d ranks: loaded %ld records, %ld insert failures, "
+           "verification %s\n", size, records, total_failed,
+           total_wrong == 0 ? "PASS" : "FAIL");
+  }
+
+  // 3. YCSB workloads
+  struct Workload {
+    const char* name;
+    double read_fraction;
+  };
+  const Workload workloads[] = {{"A", 0.50}, {"B", 0.95}, {"C", 1.00}};
+  Rng rng{(uint64_t)rank * 7919 + 17};
+
+  for (const Workload& w : workloads) {
+    // Writers exist unless the workload is read-only.
+    bool atomic_reads = w.read_fraction < 1.0;
+    std::vector<double> batch_lat;
+    std::vector<int64_t> read_keys, write_keys, write_vals;
+
+    MPI_Barrier(comm);
+    double t0 = MPI_Wtime();
+    for (long done = 0; done < OPS_PER_RANK; done += BATCH) {
+      read_keys.clear();
+      write_keys.clear();
+      write_vals.clear();
+      for (int k = 0; k < BATCH; k++) {
+        int64_t key = record_key(zipf.next(rng.next()));
+        if (rng.next() < w.read_fraction) {
+          read_keys.push_back(key);
+        } else {
+          write_keys.push_back(key);
+          write_vals.push_back(initial_value(key));  // Same value, new write
+        }
+      }
+      double b0 = MPI_Wtime();
+      if (!read_keys.empty()) {
+        store.get_batch(read_keys, out, found, atomic_reads);
+      }
+      if (!write_keys.empty()) store.put_batch(write_keys, write_vals);
+      batch_lat.push_back(MPI_Wtime() - b0);
+    }
+    double elapsed = MPI_Wtime() - t0;
+
+    double slowest = 0.0;
+    MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    // Gather every batch latency to compute global percentiles.
+    std::vector<double> all_lat;
+    if (rank == 0) all_lat.resize(batch_lat.size() * size);
+    MPI_Gather(batch_lat.data(), (int)batch_lat.size(), MPI_DOUBLE,
+               all_lat.data(), (int)batch_lat.size(), MPI_DOUBLE, 0, comm);
+
+    if (rank == 0) {
+      double ops = (double)OPS_PER_RANK * size;
+      double p50 = percentile(all_lat, 0.50), p99 = percentile(all_lat, 0.99);
+      printf("  %6d %8s %14.0f %14.2f %14.2f %14.2f\n", size, w.name,
+             ops / slowest, p50 * 1e6, p99 * 1e6, p50 / BATCH * 1e6);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (rank == 0) {
+    printf("[Rank 0] YCSB-style benchmark: %ld records/rank, %ld ops/rank, "
+           "batch %d, zipf %.2f\n", RECORDS_PER_RANK, OPS_PER_RANK, BATCH,
+           ZIPF_THETA);
+    printf("  %6s %8s %14s %14s %14s %14s\n", "Ranks", "Workload", "Ops/s",
+           "Batch p50(us)", "Batch p99(us)", "Per-op(us)");
+  }
+
+  // Run with 1, 2, 4, ... ranks (and finally all ranks).
+  std::vector<int> counts;
+  for (int p = 1; p < size; p *= 2) counts.push_back(p);
+  counts.push_back(size);
+
+  for (int p : counts) {
+    MPI_Comm sub;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &sub);
+    if (sub != MPI_COMM_NULL) {
+      long records = RECORDS_PER_RANK * p;
+      Zipfian zipf(records, ZIPF_THETA);
+      run_config(sub, zipf, records);
+      MPI_Comm_free(&sub);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 rma_kvstore.cpp -o rma_kvstore.bin
+ *
+ * 2. Run:
+ * mpirun -np 4 ./rma_kvstore.bin
+ *
+ * Note: Open MPI 4.1's default one-sided component (osc/rdma) can crash
+ * inside MPI_Compare_and_swap over shared memory. If that happens, select
+ * the UCX component instead:
+ * mpirun --mca osc ucx -np 4 ./rma_kvstore.bin
+ *
+ * 3. Run on the cluster:
+ * mpirun --hostfile hosts \
+ *        --mca btl_tcp_if_include 10.140.0.0/16 \
+ *        ~/rma_kvstore.bin
+ * ============================================================
+ */
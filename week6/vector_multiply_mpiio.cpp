@@ -0,0 +1,176 @@
+/*
+ * File:    vector_multiply_mpiio.cpp
+ *
+ * Purpose: vector_multiply_irregular.cpp without the final MPI_Gatherv.
+ * Gathering everything to Rank 0 just to save it creates "incast" (every
+ * rank sends to one NIC at once) and limits the output to Rank 0's memory.
+ * Here every rank writes its own slice straight into a shared file with the
+ * collective MPI_File_write_at_all, using the same count/displacement logic.
+ *
+ * Collective I/O ("two-phase I/O"):
+ * ROMIO picks a few "aggregator" ranks (cb_nodes). Phase 1 shuffles data
+ * among ranks so each aggregator owns one large contiguous file region;
+ * phase 2 lets the aggregators issue big writes of up to cb_buffer_size
+ * bytes. Both are tunable hints passed through MPI_Info.
+ *
+ * Options:
+ *   -n <N>        Number of elements (default 1003, accepts e.g. 1e9)
+ *   -o <file>     Output file (default result.bin)
+ *   -a <nodes>    cb_nodes hint (number of aggregators)
+ *   -b <bytes>    cb_buffer_size hint
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-09
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int world_rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  long long N = 1003;
+  const char *path = "result.bin";
+  const char *cb_nodes = nullptr;
+  const char *cb_buffer_size = nullptr;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) N = (long long)strtod(argv[i + 1], nullptr);
+    if (strcmp(argv[i], "-o") == 0) path = argv[i + 1];
+    if (strcmp(argv[i], "-a") == 0) cb_nodes = argv[i + 1];
+    if (strcmp(argv[i], "-b") == 0) cb_buffer_size = argv[i + 1];
+  }
+
+  // 1. Distribution logic, computed locally by every rank
+  // Same "%" logic as vector_multiply_irregular.cpp; each rank only needs its
+  // own count and displacement, so nothing has to be sent by Rank 0.
+  long long base_count = N / world_size;
+  long long remainder = N % world_size;
+  long long my_count = base_count + (world_rank < remainder ? 1 : 0);
+  long long my_displ = world_rank * base_count +
+                       (world_rank < remainder ? world_rank : remainder);
+
+  // 2. Local data and compute (each rank generates its own slice in place)
+  std::vector<int> local_data(my_count);
+  for (long long i = 0; i < my_count; i++) {
+    local_data[i] = (int)((my_displ + i) % 1000003);
+  }
+  for (long long i = 0; i < my_count; i++) {
+    local_data[i] *= 2;
+  }
+
+  // 3. Collective I/O hints
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "romio_cb_write", "enable");
+  if (cb_nodes != nullptr) MPI_Info_set(info, "cb_nodes", cb_nodes);
+  if (cb_buffer_size != nullptr) {
+    MPI_Info_set(info, "cb_buffer_size", cb_buffer_size);
+  }
+
+  MPI_File fh;
+  int err = MPI_File_open(MPI_COMM_WORLD, path,
+                          MPI_MODE_CREATE | MPI_MODE_WRONLY, info, &fh);
+  if (err != MPI_SUCCESS) {
+    if (world_rank == 0) printf("Error: Cannot open %s for writing.\n", path);
+    MPI_Info_free(&info);
+    MPI_Finalize();
+    return 0;
+  }
+  MPI_File_set_size(fh, 0);  // Truncate a previous, longer result
+
+  // Report the hints the library actually applied.
+  if (world_rank == 0) {
+    MPI_Info used;
+    MPI_File_get_info(fh, &used);
+    char value[MPI_MAX_INFO_VAL + 1];
+    int flag;
+    const char *keys[] = {"cb_nodes", "cb_buffer_size", "romio_cb_write"};
+    for (const char *key : keys) {
+      MPI_Info_get(used, key, MPI_MAX_INFO_VAL, value, &flag);
+      printf("[Master] Hint %-15s = %s\n", key, flag ? value : "(not set)");
+    }
+    MPI_Info_free(&used);
+  }
+
+  // 4. COLLECTIVE WRITE
+  // Every rank writes at byte offset displ * sizeof(int). The offset is an
+  // MPI_Offset (64-bit). The count is an int, so write in chunks if needed.
+  const long long CHUNK = 1LL << 28;  // ints per call (1 GiB)
+  long long max_count = 0;
+  MPI_Allreduce(&my_count, &max_count, 1, MPI_LONG_LONG, MPI_MAX,
+                MPI_COMM_WORLD);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t0 = MPI_Wtime();
+  // Every rank must make the same number of collective calls.
+  for (long long done = 0; done < max_count; done += CHUNK) {
+    long long n = 0;
+    if (done < my_count) n = (my_count - done < CHUNK) ? my_count - done : CHUNK;
+    MPI_Offset offset = (MPI_Offset)(my_displ + done) * sizeof(int);
+    MPI_File_write_at_all(fh, offset, local_data.data() + done, (int)n,
+                          MPI_INT, MPI_STATUS_IGNORE);
+  }
+  MPI_File_close(&fh);  // Close flushes, so it is part of the write time
+  double t_write = MPI_Wtime() - t0;
+  MPI_Info_free(&info);
+
+  double max_time = 0.0;
+  MPI_Reduce(&t_write, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  // 5. Verification: every rank reads back its own slice collectively
+  std::vector<int> check(my_count);
+  MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+  for (long long done = 0; done < max_count; done += CHUNK) {
+    long long n = 0;
+    if (done < my_count) n = (my_count - done < CHUNK) ? my_count - done : CHUNK;
+    MPI_Offset offset = (MPI_Offset)(my_displ + done) * sizeof(int);
+    MPI_File_read_at_all(fh, offset, check.data() + done, (int)n, MPI_INT,
+                         MPI_STATUS_IGNORE);
+  }
+  MPI_Offset file_size;
+  MPI_File_get_size(fh, &file_size);
+  MPI_File_close(&fh);
+
+  long long my_errors = 0, errors = 0;
+  for (long long i = 0; i < my_count; i++) {
+    if (check[i] != 2 * (int)((my_displ + i) % 1000003)) my_errors++;
+  }
+  MPI_Reduce(&my_errors, &errors, 1, MPI_LONG_LONG, MPI_SUM, 0,
+             MPI_COMM_WORLD);
+
+  if (world_rank == 0) {
+    double mb = N * sizeof(int) / 1e6;
+    printf("[Master] Wrote %lld elements (%.1f MB) to %s from %d ranks\n", N,
+           mb, path, world_size);
+    printf("[Master] File size: %lld bytes (expected %lld)\n",
+           (long long)file_size, N * (long long)sizeof(int));
+    printf("[Master] Write time: %.4f s, bandwidth: %.1f MB/s\n", max_time,
+           mb / max_time);
+    printf("[Master] Verification: %lld mismatches -> %s\n", errors,
+           errors == 0 && file_size == N * (long long)sizeof(int) ? "PASS"
+                                                                   : "FAIL");
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/**
+ * To setup the system
+ * On Ubuntu: sudo apt install openmpi-bin libopenmpi-dev build-essential
+ * On MacOS: brew install open-mpi
+ * To compile: mpic++ -O2 vector_multiply_mpiio.cpp -o vector_mpiio.bin
+ * To run
+ * Multiple processes: mpirun -np 4 ./vector_mpiio.bin
+ * Bandwidth test:     mpirun -np 4 ./vector_mpiio.bin -n 1e9 -a 2 -b 16777216
+ * Inspect the result: od -A d -t d4 result.bin | head
+ * Note: on a cluster the output path must be on a shared file system.
+ */
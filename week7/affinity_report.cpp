@@ -0,0 +1,434 @@
+/*
+ * File:    affinity_report.cpp
+ *
+ * Purpose: Check where ranks and threads actually run, pin them with a
+ * built-in policy, and measure what the placement does to memory bandwidth.
+ * proc_name.cpp and mpi_cluster_test.cpp print only the hostname, so two
+ * ranks fighting over the same core (or the same memory controller) look
+ * exactly like two ranks that are nicely spread out.
+ *
+ * Linux terms used below:
+ * - CPU set ("affinity mask"): the CPUs the scheduler may run a thread on.
+ *   mpirun --bind-to core/socket/none sets it at launch; sched_setaffinity /
+ *   pthread_setaffinity_np change it later.
+ * - Topology comes from /sys: package (socket) and core of every CPU, and
+ *   the CPU list of every NUMA node.
+ *
+ * Pinning policies (applied per node, using the node-local rank from
+ * MPI_Comm_split_type; threads = -t):
+ *   none     keep what mpirun gave us (the baseline)
+ *   compact  fill CPUs in order: socket 0 first, neighbors share caches
+ *   scatter  round-robin over sockets, spreading memory traffic
+ *   socket   local rank r gets all CPUs of socket r % sockets, and its
+ *            threads float inside that socket
+ *
+ * Scenario (per policy):
+ * 1. Every thread applies its CPU set and records where it runs.
+ * 2. Every thread runs a STREAM-triad probe (a[i] = b[i] + s * c[i]) on
+ *    arrays it first-touched itself, at the same time on all ranks.
+ * 3. Rank 0 prints the placement, warns about oversubscription and overlap,
+ *    and reports the bandwidth per node.
+ *
+ * Options:
+ *   -t <T>        Threads per rank (hybrid mode, default 1)
+ *   -p <policy>   none | compact | scatter | socket (default: all four)
+ *   -m <MiB>      Probe array size per thread, 3 arrays (default 32)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-16
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int PROBE_REPS = 5;
+const char* POLICIES[] = {"none", "compact", "scatter", "socket"};
+const int NUM_POLICIES = 4;
+
+struct CpuInfo {
+  int cpu, package, core, node;
+};
+
+// Parse a sysfs CPU list like "0-3,8,10-11".
+std::vector<int> parse_cpulist(const char* s) {
+  std::vector<int> cpus;
+  while (*s) {
+    char* end;
+    int lo = (int)strtol(s, &end, 10);
+    int hi = lo;
+    if (end == s) break;
+    if (*end == '-') hi = (int)strtol(end + 1, &end, 10);
+    for (int c = lo; c <= hi; c++) cpus.push_back(c);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return cpus;
+}
+
+bool read_line(const std::string& path, char* buf, int len) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (f == nullptr) return false;
+  bool ok = fgets(buf, len, f) != nullptr;
+  fclose(f);
+  return ok;
+}
+
+int read_int(const std::string& path, int fallback) {
+  char buf[64];
+  return read_line(path, buf, sizeof(buf)) ? atoi(buf) : fallback;
+}
+
+std::vector<CpuInfo> read_topology() {
+  char buf[4096];
+  std::vector<int> online = {0};
+  if (read_line("/sys/devices/system/cpu/online", buf, sizeof(buf))) {
+    online = parse_cpulist(buf);
+  }
+
+  std::map<int, int> node_of;
+  for (int n = 0; n < 1024; n++) {
+    std::string path =
+        "/sys/devices/system/node/node" + std::to_string(n) + "/cpulist";
+    if (!read_line(path, buf, sizeof(buf))) {
+      if (n > 0 && node_of.empty()) break;
+      continue;
+    }
+    for (int c : parse_cpulist(buf)) node_of[c] = n;
+  }
+
+  std::vector<CpuInfo> topo;
+  for (int c : online) {
+    std::string dir =
+        "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+    CpuInfo info;
+    info.cpu = c;
+    info.package = read_int(dir + "physical_package_id", 0);
+    info.core = read_int(dir + "core_id", c);
+    info.node = node_of.count(c) ? node_of[c] : 0;
+    topo.push_back(info);
+  }
+  return topo;
+}
+
+// "0-3,8" style string of a CPU set.
+void format_cpuset(const cpu_set_t& set, char* out, int len) {
+  std::string s;
+  for (int c = 0; c < CPU_SETSIZE; c++) {
+    if (!CPU_ISSET(c, &set)) continue;
+    int hi = c;
+    while (hi + 1 < CPU_SETSIZE && CPU_ISSET(hi + 1, &set)) hi++;
+    if (!s.empty()) s += ",";
+    s += std::to_string(c);
+    if (hi > c) s += "-" + std::to_string(hi);
+    c = hi;
+  }
+  snprintf(out, len, "%s", s.c_str());
+}
+
+// CPU set of each thread of this rank under 'policy'.
+// Returns an empty list for "none" (keep the inherited mask).
+std::vector<cpu_set_t> plan_policy(const char* policy,
+                                   const std::vector<CpuInfo>& topo,
+                                   int local_rank, int threads) {
+  std::vector<cpu_set_t> sets;
+  if (strcmp(policy, "none") == 0) return sets;
+  int ncpu = (int)topo.size();
+  sets.resize(threads);
+  for (cpu_set_t& s : sets) CPU_ZERO(&s);
+
+  // Order CPUs by (package, core, cpu): this IS the compact order.
+  std::vector<CpuInfo> order = topo;
+  std::sort(order.begin(), order.end(),
+            [](const CpuInfo& a, const CpuInfo& b) {
+              if (a.package != b.package) return a.package < b.package;
+              if (a.core != b.core) return a.core < b.core;
+              return a.cpu < b.cpu;
+            });
+  std::vector<int> packages;
+  for (const CpuInfo& c : order) {
+    if (packages.empty() || packages.back() != c.package) {
+      packages.push_back(c.package);
+    }
+  }
+
+  if (strcmp(policy, "scatter") == 0) {
+    // Interleave the packages: 1st CPU of each, 2nd CPU of each, ...
+    std::vector<std::vector<CpuInfo>> per_pkg(packages.size());
+    for (const CpuInfo& c : order) {
+      int p = (int)(std::find(packages.begin(), packages.end(), c.package) -
+                    packages.begin());
+      per_pkg[p].push_back(c);
+    }
+    order.clear();
+    for (size_t i = 0; order.size() < topo.size(); i++) {
+      for (auto& list : per_pkg) {
+        if (i < list.size()) order.push_back(list[i]);
+      }
+    }
+  }
+
+  if (strcmp(policy, "socket") == 0) {
+    int pkg = packages[local_rank % packages.size()];
+    for (cpu_set_t& s : sets) {
+      for (const CpuInfo& c : topo) {
+        if (c.package == pkg) CPU_SET(c.cpu, &s);
+      }
+    }
+    return sets;
+  }
+
+  // compact / scatter: one CPU per thread, wrapping if oversubscribed.
+  for (int t = 0; t < threads; t++) {
+    CPU_SET(order[(local_rank * threads + t) % ncpu].cpu, &sets[t]);
+  }
+  return sets;
+}
+
+// One line of the report (plain bytes, gathered with MPI_BYTE).
+struct Placement {
+  char host[MPI_MAX_PROCESSOR_NAME];
+  int rank, thread, running_on, node;
+  cpu_set_t allowed;
+  double gbps;
+};
+
+// Worker threads: pin, first-touch, wait for the start signal, probe.
+struct ProbeGroup {
+  std::mutex m;
+  std::condition_variable cv;
+  int ready = 0;
+  bool go = false;
+};
+
+void probe_thread(ProbeGroup* group, const cpu_set_t* set, size_t n,
+                  const std::vector<CpuInfo>* topo, Placement* out) {
+  if (set != nullptr) {
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), set);
+  }
+  std::vector<double> a(n), b(n), c(n);  // First touch by this thread
+  for (size_t i = 0; i < n; i++) {
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+  {
+    std::unique_lock<std::mutex> lock(group->m);
+    group->ready++;
+    group->cv.notify_all();
+    group->cv.wait(lock, [group] { return group->go; });
+  }
+
+  // Total (not best) time, so threads sharing a CPU are not flattered by
+  // a repetition that happened to run alone.
+  // MPI is only called by the main thread, so time with std::chrono.
+  auto t0 = std::chrono::steady_clock::now();
+  for (int rep = 0; rep < PROBE_REPS; rep++) {
+    for (size_t i = 0; i < n; i++) a[i] = b[i] + 3.0 * c[i];
+  }
+  double t = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           t0).count();
+  if (a[n / 2] != 7.0) printf("Error: triad result is wrong\n");
+
+  out->gbps = 3.0 * n * sizeof(double) * PROBE_REPS / t / 1e9;
+  out->running_on = sched_getcpu();
+  out->node = 0;
+  for (const CpuInfo& ci : *topo) {
+    if (ci.cpu == out->running_on) out->node = ci.node;
+  }
+  pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &out->allowed);
+}
+
+void report(const char* policy, const std::vector<Placement>& all) {
+  printf("================ Policy: %s ================\n", policy);
+  printf("  %4s %6s %-16s %-18s %7s %5s %8s\n", "Rank", "Thread", "Host",
+         "CPU set", "Running", "NUMA", "GB/s");
+  char cpus[256];
+  for (const Placement& p : all) {
+    format_cpuset(p.allowed, cpus, sizeof(cpus));
+    printf("  %4d %6d %-16s %-18s %7d %5d %8.2f\n", p.rank, p.thread, p.host,
+           cpus, p.running_on, p.node, p.gbps);
+  }
+
+  // Per host: bandwidth sum, oversubscription and overlap checks.
+  std::map<std::string, std::vector<const Placement*>> by_host;
+  for (const Placement& p : all) by_host[p.host].push_back(&p);
+  for (auto& entry : by_host) {
+    const std::vector<const Placement*>& list = entry.second;
+    double sum = 0.0;
+    cpu_set_t any;
+    CPU_ZERO(&any);
+    for (const Placement* p : list) {
+      sum += p->gbps;
+      CPU_OR(&any, &any, &p->allowed);
+    }
+    int usable = CPU_COUNT(&any);
+
+    // A thread allowed on every CPU is unbound (it may migrate); overlap is
+    // only reported between bound threads of different ranks.
+    int unbound = 0, overlaps = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+      bool free_i = usable > 1 && CPU_COUNT(&list[i]->allowed) == usable;
+      if (free_i) unbound++;
+      for (size_t j = i + 1; j < list.size(); j++) {
+        bool free_j = usable > 1 && CPU_COUNT(&list[j]->allowed) == usable;
+        if (free_i || free_j || list[i]->rank == list[j]->rank) continue;
+        cpu_set_t both;
+        CPU_AND(&both, &list[i]->allowed, &list[j]->allowed);
+        if (CPU_COUNT(&both) > 0) overlaps++;
+      }
+    }
+    printf("[Rank 0] %s: %zu threads on %d CPUs, total bandwidth %.2f GB/s\n",
+           entry.first.c_str(), list.size(), usable, sum);
+    if ((int)list.size() > usable) {
+      printf("[Rank 0] WARNING: %s is oversubscribed (%zu threads > %d "
+             "CPUs)\n",
+             entry.first.c_str(), list.size(), usable);
+    }
+    if (overlaps > 0) {
+      printf("[Rank 0] WARNING: %s has %d pair(s) of threads from different "
+             "ranks with overlapping CPU sets\n",
+             entry.first.c_str(), overlaps);
+    }
+    if (unbound > 0) {
+      printf("[Rank 0] Note: %d thread(s) on %s are unbound and may migrate\n",
+             unbound, entry.first.c_str());
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int threads = 1;
+  const char* only_policy = nullptr;
+  long long probe_mib = 32;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-t") == 0) threads = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-p") == 0) only_policy = argv[i + 1];
+    if (strcmp(argv[i], "-m") == 0) probe_mib = atoll(argv[i + 1]);
+  }
+  size_t n = (size_t)(probe_mib << 20) / sizeof(double);
+
+  // 1. Node-local rank and topology
+  MPI_Comm node_comm;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                      MPI_INFO_NULL, &node_comm);
+  int local_rank;
+  MPI_Comm_rank(node_comm, &local_rank);
+
+  std::vector<CpuInfo> topo = read_topology();
+  char host[MPI_MAX_PROCESSOR_NAME];
+  int len;
+  MPI_Get_processor_name(host, &len);
+
+  cpu_set_t launch_mask;  // What mpirun gave us ("none" restores it)
+  sched_getaffinity(0, sizeof(cpu_set_t), &launch_mask);
+
+  if (rank == 0) {
+    int packages = 0, nodes = 0;
+    for (const CpuInfo& c : topo) {
+      packages = std::max(packages, c.package + 1);
+      nodes = std::max(nodes, c.node + 1);
+    }
+    printf("[Rank 0] %s: %zu CPUs, %d socket(s), %d NUMA node(s); %d ranks "
+           "x %d thread(s)\n",
+           host, topo.size(), packages, nodes, size, threads);
+  }
+
+  // 2. Apply each policy and probe
+  for (int pi = 0; pi < NUM_POLICIES; pi++) {
+    const char* policy = POLICIES[pi];
+    if (only_policy != nullptr && strcmp(only_policy, policy) != 0) continue;
+
+    std::vector<cpu_set_t> sets = plan_policy(policy, topo, local_rank,
+                                              threads);
+    if (sets.empty()) {
+      sched_setaffinity(0, sizeof(cpu_set_t), &launch_mask);
+    } else {
+      cpu_set_t all;  // The process (main thread) gets the union
+      CPU_ZERO(&all);
+      for (cpu_set_t& s : sets) CPU_OR(&all, &all, &s);
+      if (sched_setaffinity(0, sizeof(cpu_set_t), &all) != 0) {
+        printf("[Rank %d] Warning: cannot apply policy %s (restricted by the "
+               "launcher? try --bind-to none)\n",
+               rank, policy);
+      }
+    }
+
+    std::vector<Placement> mine(threads);
+    for (int t = 0; t < threads; t++) {
+      memset(&mine[t], 0, sizeof(Placement));
+      snprintf(mine[t].host, sizeof(mine[t].host), "%s", host);
+      mine[t].rank = rank;
+      mine[t].thread = t;
+    }
+
+    ProbeGroup group;
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+      const cpu_set_t* set = sets.empty() ? nullptr : &sets[t];
+      pool.emplace_back(probe_thread, &group, set, n, &topo, &mine[t]);
+    }
+    {
+      std::unique_lock<std::mutex> lock(group.m);
+      group.cv.wait(lock, [&] { return group.ready == threads; });
+    }
+    MPI_Barrier(MPI_COMM_WORLD);  // Probe on all ranks at the same time
+    {
+      std::lock_guard<std::mutex> lock(group.m);
+      group.go = true;
+    }
+    group.cv.notify_all();
+    for (std::thread& th : pool) th.join();
+
+    // 3. Gather and report
+    std::vector<Placement> all(rank == 0 ? size * threads : 0);
+    MPI_Gather(mine.data(), threads * (int)sizeof(Placement), MPI_BYTE,
+               all.data(), threads * (int)sizeof(Placement), MPI_BYTE, 0,
+               MPI_COMM_WORLD);
+    if (rank == 0) report(policy, all);
+  }
+
+  MPI_Comm_free(&node_comm);
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 -pthread affinity_report.cpp -o affinity_report.bin
+ *
+ * 2. Run (let the program do the pinning):
+ * mpirun -np 4 --bind-to none ./affinity_report.bin -t 2
+ *
+ * 3. Check what mpirun's own binding does ("none" policy only):
+ * mpirun -np 4 --bind-to core --report-bindings ./affinity_report.bin -p none
+ * mpirun -np 4 --hostfile ../week2/hosts ./affinity_report.bin -p none
+ *
+ * Observation:
+ * With "none" and --bind-to none every rank may run anywhere (CPU set =
+ * all CPUs). compact packs ranks onto the first socket and shares its
+ * memory controller; scatter and socket spread ranks over sockets and
+ * usually give the highest total bandwidth on a multi-socket node. More
+ * threads than CPUs triggers the oversubscription warning.
+ * ============================================================
+ */
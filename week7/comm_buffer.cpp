@@ -0,0 +1,352 @@
+/*
+ * File:    comm_buffer.cpp
+ *
+ * Purpose: A communication buffer type that avoids needless initialization
+ * and controls where its pages come from.
+ * Every program so far allocates buffers like
+ *     std::vector<int> recv_buf(N, 0);   or   std::vector<int> local(n);
+ * Both write every element once (value-initialization) right before
+ * MPI_Recv/MPI_Scatterv overwrites it again. For large N that is a full
+ * extra pass over memory. It also decides the NUMA placement: Linux puts a
+ * page on the NUMA node of the thread that touches it FIRST, so the thread
+ * that zero-fills the vector decides where the data lives, not the threads
+ * that later compute on it.
+ *
+ * CommBuffer<T>:
+ * - Never initializes its elements (like malloc, unlike std::vector).
+ * - Three sources of memory:
+ *     HEAP     posix_memalign, 64-byte aligned
+ *     MPI      MPI_Alloc_mem; some networks need registered ("pinned")
+ *              memory for RDMA and can hand it out pre-registered
+ *     HUGE     mmap in 2 MiB huge pages: MAP_HUGETLB if the admin has
+ *              reserved huge pages, else transparent huge pages (madvise)
+ * - first_touch(threads): each worker thread touches one element per page
+ *   of exactly the range it will later compute on, so every page lands on
+ *   the NUMA node of its owner. One write per 4 KiB instead of a memset.
+ *   Worker t is pinned to the same CPU (pthread_setaffinity_np) in the
+ *   first-touch pass and in the compute pass; unpinned threads could be
+ *   scheduled on another node the second time around.
+ *
+ * Note: the kernel still hands out zeroed pages (security). What is saved
+ * is the user-space pass, and the page faults happen where they are needed.
+ *
+ * Scenario:
+ * 1. Ranks form a ring; every rank receives N ints from its left neighbor
+ *    with MPI_Sendrecv into a freshly allocated buffer, twice.
+ * 2. The received data is processed by T threads (multiply by 2).
+ * 3. Allocation, 1st/2nd transfer and compute times are compared for a
+ *    zero-filled std::vector and each CommBuffer variant.
+ *
+ * Options:
+ *   -n <N>        Number of ints per rank (default 2^25, accepts e.g. 1e8,
+ *                 at most INT_MAX: it is the MPI count)
+ *   -t <T>        Compute threads per rank (default 2)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-16
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+const size_t HUGE_PAGE = 2UL << 20;
+
+enum AllocKind { ALLOC_HEAP, ALLOC_MPI, ALLOC_HUGE };
+
+// CPUs this rank was bound to at launch (mpirun --bind-to), in order.
+std::vector<int> launch_cpus() {
+  cpu_set_t set;
+  std::vector<int> cpus;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+      if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+// Run fn(begin, end) on 'threads' threads with the usual "%" split.
+// first_touch() and the compute loop use the same split, and thread t is
+// pinned to the same CPU every time, so each page is touched first by the
+// thread (and NUMA node) that works on it later.
+template <typename F>
+void parallel_for(int threads, size_t n, F fn) {
+  static const std::vector<int> cpus = launch_cpus();
+  std::vector<std::thread> pool;
+  size_t base = n / threads, rem = n % threads;
+  size_t begin = 0;
+  for (int t = 0; t < threads; t++) {
+    size_t count = base + ((size_t)t < rem ? 1 : 0);
+    int cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+    pool.emplace_back([fn, cpu, begin, count] {
+      if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      }
+      fn(begin, begin + count);
+    });
+    begin += count;
+  }
+  for (std::thread& th : pool) th.join();
+}
+
+template <typename T>
+class CommBuffer {
+ public:
+  CommBuffer(size_t n, AllocKind kind) : n_(n), kind_(kind) {
+    size_t bytes = n * sizeof(T);
+    void* p = nullptr;
+    if (kind == ALLOC_HEAP) {
+      if (posix_memalign(&p, 64, bytes) != 0) p = nullptr;
+      desc_ = "heap (posix_memalign)";
+    } else if (kind == ALLOC_MPI) {
+      MPI_Alloc_mem((MPI_Aint)bytes, MPI_INFO_NULL, &p);
+      desc_ = "MPI_Alloc_mem";
+    } else {
+      mapped_ = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+      p = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      desc_ = "huge pages (hugetlbfs)";
+      if (p == MAP_FAILED) {
+        // No reserved huge pages: ask for transparent huge pages instead.
+        // mmap of >= 2 MiB is not always 2 MiB aligned, so over-allocate.
+        size_t len = mapped_ + HUGE_PAGE;
+        char* raw = (char*)mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+          p = nullptr;
+        } else {
+          uintptr_t addr = ((uintptr_t)raw + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+          size_t head = addr - (uintptr_t)raw;
+          if (head > 0) munmap(raw, head);
+          munmap((char*)addr + mapped_, HUGE_PAGE - head);
+          p = (void*)addr;
+          madvise(p, mapped_, MADV_HUGEPAGE);
+          desc_ = "huge pages (THP madvise)";
+        }
+      }
+    }
+    if (p == nullptr) {
+      fprintf(stderr, "Error: cannot allocate %zu bytes (%s)\n", bytes, desc_);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    data_ = (T*)p;
+  }
+
+  ~CommBuffer() {
+    if (kind_ == ALLOC_HEAP) free(data_);
+    if (kind_ == ALLOC_MPI) MPI_Free_mem(data_);
+    if (kind_ == ALLOC_HUGE) munmap(data_, mapped_);
+  }
+
+  CommBuffer(const CommBuffer&) = delete;
+  CommBuffer& operator=(const CommBuffer&) = delete;
+
+  // Fault in every page from the thread that owns it (see parallel_for).
+  void first_touch(int threads) {
+    size_t per_page = 4096 / sizeof(T);
+    T* d = data_;
+    parallel_for(threads, n_, [d, per_page](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i += per_page) d[i] = T();
+    });
+  }
+
+  T* data() { return data_; }
+  size_t size() const { return n_; }
+  T& operator[](size_t i) { return data_[i]; }
+  const char* description() const { return desc_; }
+
+ private:
+  T* data_ = nullptr;
+  size_t n_;
+  AllocKind kind_;
+  size_t mapped_ = 0;  // Length of the mapping (huge pages only)
+  const char* desc_ = "";
+};
+
+// NUMA node of the page holding 'addr' (-1 if the kernel won't tell us).
+int numa_node_of(void* addr) {
+  int node = -1;
+  const unsigned long MPOL_F_NODE = 1, MPOL_F_ADDR = 2;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr,
+              MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+    return -1;
+  }
+  return node;
+}
+
+// Anonymous memory of this process currently backed by huge pages.
+long anon_huge_kb() {
+  FILE* f = fopen("/proc/self/smaps_rollup", "r");
+  if (f == nullptr) return -1;
+  char line[256];
+  long kb = -1;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+  }
+  fclose(f);
+  return kb;
+}
+
+struct Timing {
+  double alloc, transfer1, transfer2, compute;
+  long errors;
+};
+
+// Ring transfer into 'recv' (twice), then the threaded compute pass.
+void transfer_and_compute(const int* send, int* recv, int n, int threads,
+                          Timing& t) {
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  int right = (rank + 1) % size, left = (rank - 1 + size) % size;
+
+  double* slots[2] = {&t.transfer1, &t.transfer2};
+  for (double* slot : slots) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    MPI_Sendrecv(send, n, MPI_INT, right, 0, recv, n, MPI_INT, left, 0,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    *slot = MPI_Wtime() - t0;
+  }
+
+  double t0 = MPI_Wtime();
+  parallel_for(threads, n, [recv](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) recv[i] *= 2;
+  });
+  t.compute = MPI_Wtime() - t0;
+
+  t.errors = 0;
+  for (int i = 0; i < n; i++) {
+    if (recv[i] != 2 * ((left + i) % 1000003)) t.errors++;
+  }
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  long long N = 1LL << 25;
+  int threads = 2;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) N = (long long)strtod(argv[i + 1], nullptr);
+    if (strcmp(argv[i], "-t") == 0) threads = atoi(argv[i + 1]);
+  }
+  if (N < 1 || N > INT_MAX || threads < 1) {
+    if (rank == 0) {
+      printf("Error: -n must be in [1, %d] (MPI count) and -t >= 1.\n",
+             INT_MAX);
+    }
+    MPI_Finalize();
+    return 0;
+  }
+  int n = (int)N;
+
+  // 1. Send buffer (same for every variant)
+  CommBuffer<int> send(n, ALLOC_HEAP);
+  for (int i = 0; i < n; i++) send[i] = (rank + i) % 1000003;
+
+  const int NUM_VARIANTS = 5;
+  const char* labels[NUM_VARIANTS] = {
+      "std::vector<int>(N, 0)", "CommBuffer heap", "CommBuffer MPI_Alloc_mem",
+      "CommBuffer huge pages", "CommBuffer heap + first-touch"};
+  double times[NUM_VARIANTS][4];
+  long errors[NUM_VARIANTS];
+  const char* huge_desc = "";
+  long huge_kb = -1;
+  int first_touch_node = -1;
+
+  // 2. One fresh receive buffer per variant
+  for (int v = 0; v < NUM_VARIANTS; v++) {
+    Timing t;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    if (v == 0) {
+      std::vector<int> recv(n, 0);
+      t.alloc = MPI_Wtime() - t0;
+      transfer_and_compute(send.data(), recv.data(), n, threads, t);
+    } else {
+      AllocKind kind = (v == 2) ? ALLOC_MPI : (v == 3) ? ALLOC_HUGE : ALLOC_HEAP;
+      CommBuffer<int> recv(n, kind);
+      if (v == 4) recv.first_touch(threads);
+      t.alloc = MPI_Wtime() - t0;
+      transfer_and_compute(send.data(), recv.data(), n, threads, t);
+      if (v == 3) {
+        huge_desc = recv.description();
+        huge_kb = anon_huge_kb();
+      }
+      if (v == 4) first_touch_node = numa_node_of(recv.data());
+    }
+    double mine[4] = {t.alloc, t.transfer1, t.transfer2, t.compute};
+    MPI_Reduce(mine, times[v], 4, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&t.errors, &errors[v], 1, MPI_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+  }
+
+  // 3. Report (max over ranks)
+  if (rank == 0) {
+    printf("[Rank 0] Ring transfer of %d ints (%.1f MB) per rank, %d ranks, "
+           "%d compute threads\n",
+           n, n * 4.0 / 1e6, size, threads);
+    printf("  %-30s %9s %9s %9s %9s %9s  %s\n", "Receive buffer", "Alloc",
+           "1st xfer", "2nd xfer", "Compute", "Total", "Check");
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+      double* t = times[v];
+      printf("  %-30s %9.2f %9.2f %9.2f %9.2f %9.2f  %s\n", labels[v],
+             t[0] * 1e3, t[1] * 1e3, t[2] * 1e3, t[3] * 1e3,
+             (t[0] + t[1] + t[3]) * 1e3, errors[v] == 0 ? "PASS" : "FAIL");
+    }
+    printf("  (times in ms; Total = alloc + 1st transfer + compute)\n");
+    printf("[Rank 0] Huge page buffer: %s, AnonHugePages = %ld kB\n",
+           huge_desc, huge_kb);
+    if (first_touch_node >= 0) {
+      printf("[Rank 0] First-touch buffer starts on NUMA node %d\n",
+             first_touch_node);
+    } else {
+      printf("[Rank 0] NUMA node query (get_mempolicy) not available\n");
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 -pthread comm_buffer.cpp -o comm_buffer.bin
+ *
+ * 2. Run (bind ranks to NUMA domains so first-touch is meaningful):
+ * mpirun -np 4 --map-by numa --bind-to numa ./comm_buffer.bin -n 1e8 -t 4
+ *
+ * 3. Optional: reserve real (non-transparent) huge pages first
+ * sudo sysctl vm.nr_hugepages=1024
+ *
+ * Observation:
+ * The zero-filled vector pays a full memset in "Alloc". The CommBuffer
+ * variants allocate in microseconds; their page faults show up in the
+ * 1st transfer instead (the 2nd transfer is the same for all), so the
+ * total is still lower. Huge pages take 512x fewer faults, but each one
+ * zeroes 2 MiB; their gain shows in the compute pass (fewer TLB misses).
+ * On a multi-socket node, first-touch makes the threaded compute faster.
+ * ============================================================
+ */
@@ -0,0 +1,289 @@
+/*
+ * File:    fuzzy_barrier.cpp
+ *
+ * Purpose: A split-phase ("fuzzy") barrier and two hand-written barrier
+ * algorithms, compared with MPI_Barrier on the skewed workload of
+ * barrier_demo.cpp.
+ *
+ * In barrier_demo.cpp the fast ranks sit inside MPI_Barrier doing nothing
+ * until the slowest rank arrives. Often a rank still has work that does not
+ * depend on the other ranks (e.g. preparing the next phase). A split-phase
+ * barrier separates the two halves of a barrier:
+ *   arrive() - "I am done with the phase" (MPI_Ibarrier, returns at once)
+ *   wait()   - "I need everyone to be done now" (MPI_Wait)
+ * Everything between arrive() and wait() overlaps with the waiting.
+ *
+ * Barrier algorithms (zero-byte messages on a private communicator):
+ * - Dissemination: in round k rank r signals (r + 2^k) % p and waits for
+ *   (r - 2^k) % p. After ceil(log2 p) rounds every rank has heard, directly
+ *   or indirectly, from every other rank.
+ * - Tournament: ranks are paired like a knockout bracket. The loser of each
+ *   match notifies the winner and waits; rank 0 wins the final and then
+ *   wakes up the ranks it beat, which wake up the ranks they beat, etc.
+ *
+ * Scenario:
+ * 1. Correctness check: no rank may leave a barrier early.
+ * 2. Latency of each barrier without skew.
+ * 3. Skewed phases: rank r works (r * 2 + 1) time units like in
+ *    barrier_demo.cpp, then has INDEPENDENT_TASKS small tasks that do not
+ *    depend on the barrier. Idle time inside the barrier is reported per
+ *    rank for every variant.
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-16
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>  // For usleep()
+#include <vector>
+
+const int TAG_ARRIVE = 1;
+const int TAG_WAKE = 2;
+const int ROUNDS = 5;              // Skewed phases per variant
+const int INDEPENDENT_TASKS = 40;  // Barrier-independent tasks per phase
+const int TASK_US = 2000;          // Length of one independent task
+
+// Split-phase barrier on top of MPI_Ibarrier.
+class SplitBarrier {
+ public:
+  explicit SplitBarrier(MPI_Comm comm) : comm_(comm) {}
+
+  void arrive() { MPI_Ibarrier(comm_, &req_); }
+
+  // True once every rank has arrived (also drives progress).
+  bool test() {
+    int done = 0;
+    MPI_Test(&req_, &done, MPI_STATUS_IGNORE);
+    return done != 0;
+  }
+
+  void wait() { MPI_Wait(&req_, MPI_STATUS_IGNORE); }
+
+ private:
+  MPI_Comm comm_;
+  MPI_Request req_ = MPI_REQUEST_NULL;
+};
+
+void dissemination_barrier(MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  for (int d = 1; d < size; d <<= 1) {
+    MPI_Sendrecv(nullptr, 0, MPI_BYTE, (rank + d) % size, TAG_ARRIVE, nullptr,
+                 0, MPI_BYTE, (rank - d + size) % size, TAG_ARRIVE, comm,
+                 MPI_STATUS_IGNORE);
+  }
+}
+
+void tournament_barrier(MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  // Arrival: in round k the rank with bit k set loses to rank - 2^k.
+  int k = 1;
+  for (; k < size; k <<= 1) {
+    if (rank & k) {
+      MPI_Send(nullptr, 0, MPI_BYTE, rank - k, TAG_ARRIVE, comm);
+      MPI_Recv(nullptr, 0, MPI_BYTE, rank - k, TAG_WAKE, comm,
+               MPI_STATUS_IGNORE);
+      break;
+    }
+    if (rank + k < size) {
+      MPI_Recv(nullptr, 0, MPI_BYTE, rank + k, TAG_ARRIVE, comm,
+               MPI_STATUS_IGNORE);
+    }
+  }
+
+  // Wakeup: release the ranks beaten in earlier rounds, latest round first.
+  for (k >>= 1; k >= 1; k >>= 1) {
+    if (rank + k < size) {
+      MPI_Send(nullptr, 0, MPI_BYTE, rank + k, TAG_WAKE, comm);
+    }
+  }
+}
+
+// Barrier-independent work (e.g. preparing the next phase).
+void independent_task() { usleep(TASK_US); }
+
+enum Variant { BUILTIN_BARRIER, DISSEMINATION, TOURNAMENT, SPLIT_PHASE };
+const char* VARIANT_NAMES[] = {"MPI_Barrier", "Dissemination", "Tournament",
+                               "Split-phase"};
+const int NUM_VARIANTS = 4;
+
+// Run ROUNDS skewed phases. Returns this rank's average idle time per phase
+// and the average (max over ranks) phase time.
+void run_phases(Variant v, MPI_Comm comm, int unit_us, double& idle,
+                double& phase, int& early_tasks) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  idle = 0.0;
+  phase = 0.0;
+  early_tasks = 0;
+  SplitBarrier split(comm);
+
+  for (int round = 0; round < ROUNDS; round++) {
+    MPI_Barrier(comm);
+    double t_start = MPI_Wtime();
+
+    // 1. Skewed, barrier-dependent work
+    usleep((rank * 2 + 1) * unit_us);
+
+    // 2. Barrier, then the independent tasks
+    int tasks_left = INDEPENDENT_TASKS;
+    double t0 = MPI_Wtime();
+    if (v == SPLIT_PHASE) {
+      split.arrive();
+      double waited = MPI_Wtime() - t0;
+      while (tasks_left > 0) {
+        t0 = MPI_Wtime();
+        bool done = split.test();
+        waited += MPI_Wtime() - t0;
+        if (done) break;
+        independent_task();
+        tasks_left--;
+        early_tasks++;
+      }
+      t0 = MPI_Wtime();
+      split.wait();
+      idle += waited + (MPI_Wtime() - t0);
+    } else {
+      if (v == BUILTIN_BARRIER) MPI_Barrier(comm);
+      if (v == DISSEMINATION) dissemination_barrier(comm);
+      if (v == TOURNAMENT) tournament_barrier(comm);
+      idle += MPI_Wtime() - t0;
+    }
+    for (; tasks_left > 0; tasks_left--) independent_task();
+
+    double t_phase = MPI_Wtime() - t_start, t_max;
+    MPI_Allreduce(&t_phase, &t_max, 1, MPI_DOUBLE, MPI_MAX, comm);
+    phase += t_max;
+  }
+  idle /= ROUNDS;
+  phase /= ROUNDS;
+  early_tasks /= ROUNDS;
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int unit_us = 20000;  // One "work unit" of barrier_demo.cpp (20 ms)
+  if (argc > 1) unit_us = atoi(argv[1]) * 1000;
+
+  // Private communicator so barrier messages never match user messages.
+  MPI_Comm comm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+
+  // 1. Correctness: nobody may leave a barrier before the last rank enters.
+  // The last rank enters DELAY later than everyone else, so every other rank
+  // must spend at least (almost) DELAY inside each barrier.
+  const double DELAY = 0.02;
+  int errors = 0;
+  for (int v = 1; v < NUM_VARIANTS; v++) {
+    MPI_Barrier(comm);
+    double t0 = MPI_Wtime();
+    if (rank == size - 1) usleep((int)(DELAY * 1e6));
+    if (v == DISSEMINATION) dissemination_barrier(comm);
+    if (v == TOURNAMENT) tournament_barrier(comm);
+    if (v == SPLIT_PHASE) {
+      SplitBarrier split(comm);
+      split.arrive();
+      split.wait();
+    }
+    if (rank != size - 1 && MPI_Wtime() - t0 < 0.9 * DELAY) errors++;
+  }
+  int total_errors = 0;
+  MPI_Reduce(&errors, &total_errors, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (rank == 0) {
+    printf("[Rank 0] Barrier correctness check: %s\n",
+           total_errors == 0 ? "PASS" : "FAIL");
+  }
+
+  // 2. Barrier latency without skew
+  const int LAT_ITERS = 2000;
+  for (int v = 0; v < NUM_VARIANTS; v++) {
+    SplitBarrier split(comm);
+    MPI_Barrier(comm);
+    double t0 = MPI_Wtime();
+    for (int i = 0; i < LAT_ITERS; i++) {
+      if (v == BUILTIN_BARRIER) MPI_Barrier(comm);
+      if (v == DISSEMINATION) dissemination_barrier(comm);
+      if (v == TOURNAMENT) tournament_barrier(comm);
+      if (v == SPLIT_PHASE) {
+        split.arrive();
+        split.wait();
+      }
+    }
+    double t = (MPI_Wtime() - t0) / LAT_ITERS, t_max;
+    MPI_Reduce(&t, &t_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+      printf("[Rank 0] %-14s latency: %8.2f us\n", VARIANT_NAMES[v],
+             t_max * 1e6);
+    }
+  }
+
+  // 3. Skewed phases
+  double idle[NUM_VARIANTS], phase[NUM_VARIANTS];
+  int early[NUM_VARIANTS];
+  for (int v = 0; v < NUM_VARIANTS; v++) {
+    run_phases((Variant)v, comm, unit_us, idle[v], phase[v], early[v]);
+  }
+
+  std::vector<double> all_idle(size * NUM_VARIANTS);
+  std::vector<int> all_early(size * NUM_VARIANTS);
+  MPI_Gather(idle, NUM_VARIANTS, MPI_DOUBLE, all_idle.data(), NUM_VARIANTS,
+             MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  MPI_Gather(early, NUM_VARIANTS, MPI_INT, all_early.data(), NUM_VARIANTS,
+             MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    printf("--------------------------------\n");
+    printf("[Rank 0] Skewed phases: work = (rank * 2 + 1) x %d ms, then %d "
+           "independent tasks of %d ms\n",
+           unit_us / 1000, INDEPENDENT_TASKS, TASK_US / 1000);
+    printf("[Rank 0] Idle time per phase (ms):\n");
+    printf("  Rank %13s %13s %13s %13s %9s %9s\n", VARIANT_NAMES[0],
+           VARIANT_NAMES[1], VARIANT_NAMES[2], VARIANT_NAMES[3], "Saved",
+           "Overlap");
+    for (int r = 0; r < size; r++) {
+      const double* row = &all_idle[r * NUM_VARIANTS];
+      printf("  %4d %13.2f %13.2f %13.2f %13.2f %9.2f %7d t\n", r,
+             row[0] * 1e3, row[1] * 1e3, row[2] * 1e3, row[3] * 1e3,
+             (row[0] - row[3]) * 1e3, all_early[r * NUM_VARIANTS + 3]);
+    }
+    printf("[Rank 0] Phase time (ms):");
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+      printf("  %s %.2f", VARIANT_NAMES[v], phase[v] * 1e3);
+    }
+    printf("\n");
+  }
+
+  MPI_Comm_free(&comm);
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 fuzzy_barrier.cpp -o fuzzy_barrier.bin
+ *
+ * 2. Run (optional argument: work unit in ms, default 20):
+ * mpirun -np 4 ./fuzzy_barrier.bin 20
+ *
+ * Observation:
+ * With the blocking barriers, Rank 0 idles for about (size - 1) * 2 work
+ * units per phase. With the split-phase barrier it runs its independent
+ * tasks ("Overlap" column, in tasks) while waiting, so the "Saved" column
+ * is close to its old idle time and the whole phase gets shorter.
+ * ============================================================
+ */
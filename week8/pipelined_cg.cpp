@@ -0,0 +1,344 @@
+/*
+ * File:    pipelined_cg.cpp
+ *
+ * Purpose: Distributed Conjugate Gradient (CG) and pipelined CG.
+ * allreduce_demo.cpp divides a local value by a global sum. An iterative
+ * solver does the same thing every iteration: a dot product is a local sum
+ * followed by MPI_Allreduce, and every rank needs the result before it can
+ * take the next step. Standard CG has TWO such blocking reductions per
+ * iteration, so at scale the iteration time is dominated by latency.
+ *
+ * Pipelined CG (Ghysels & Vanroose, 2014) rearranges the recurrences:
+ * - both dot products of an iteration are combined into ONE reduction of
+ *   2 values, and
+ * - that reduction is started with MPI_Iallreduce and only waited for AFTER
+ *   the next matrix-vector product, which does not depend on it.
+ * The price is 3 extra vector updates per iteration and slightly worse
+ * rounding behavior (the residual is updated, never recomputed).
+ *
+ * Test problem: 2D Poisson equation on an n x n grid (5-point stencil,
+ * zero boundary), A x = b with b = A * ones, so the exact solution is 1.
+ * Grid rows are split over the ranks with the usual "%" logic; the
+ * matrix-vector product exchanges one halo row with each neighbor.
+ *
+ * Scenario:
+ * 1. CG and pipelined CG run for a fixed iteration budget (or until the
+ *    relative residual drops below the tolerance) on 1, 2, 4, ..., size
+ *    ranks (sub-communicators of the first q ranks).
+ * 2. Time per iteration, time spent waiting for reductions, speedup and
+ *    parallel efficiency are reported for both.
+ * 3. The true residual ||b - A x|| / ||b|| of both results is checked.
+ *
+ * Options:
+ *   -n <n>        Grid size per dimension (default 512, >= processes)
+ *   -i <iters>    Maximum iterations (default 200)
+ *   -t <tol>      Relative residual tolerance (default 1e-8)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-02-23
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Local block of grid rows [row0, row0 + rows) of an n x n grid.
+struct Grid {
+  int n, rows, row0;
+  int up, down;  // Neighbor ranks or MPI_PROC_NULL
+  MPI_Comm comm;
+};
+
+Grid make_grid(int n, MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  Grid g;
+  g.n = n;
+  g.comm = comm;
+  int base = n / size, rem = n % size;
+  g.rows = base + (rank < rem ? 1 : 0);
+  g.row0 = rank * base + (rank < rem ? rank : rem);
+  g.up = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+  g.down = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
+  return g;
+}
+
+// y = A x. The halo rows travel while the interior rows are computed.
+void apply_A(const Grid& g, const std::vector<double>& x,
+             std::vector<double>& y) {
+  int n = g.n, rows = g.rows;
+  std::vector<double> halo_up(n, 0.0), halo_down(n, 0.0);
+  MPI_Request reqs[4];
+  MPI_Irecv(halo_up.data(), n, MPI_DOUBLE, g.up, 0, g.comm, &reqs[0]);
+  MPI_Irecv(halo_down.data(), n, MPI_DOUBLE, g.down, 1, g.comm, &reqs[1]);
+  MPI_Isend(&x[0], n, MPI_DOUBLE, g.up, 1, g.comm, &reqs[2]);
+  MPI_Isend(&x[(size_t)(rows - 1) * n], n, MPI_DOUBLE, g.down, 0, g.comm,
+            &reqs[3]);
+
+  auto row = [&](int j, const double* above, const double* below) {
+    const double* xr = &x[(size_t)j * n];
+    double* yr = &y[(size_t)j * n];
+    for (int i = 0; i < n; i++) {
+      double left = i > 0 ? xr[i - 1] : 0.0;
+      double right = i < n - 1 ? xr[i + 1] : 0.0;
+      yr[i] = 4.0 * xr[i] - left - right - above[i] - below[i];
+    }
+  };
+  for (int j = 1; j < rows - 1; j++) {
+    row(j, &x[(size_t)(j - 1) * n], &x[(size_t)(j + 1) * n]);
+  }
+
+  MPI_Waitall(4, reqs, MPI_STATUSES_IGNORE);
+  const double* below0 = rows > 1 ? &x[n] : halo_down.data();
+  row(0, halo_up.data(), below0);
+  if (rows > 1) row(rows - 1, &x[(size_t)(rows - 2) * n], halo_down.data());
+}
+
+double local_dot(const std::vector<double>& a, const std::vector<double>& b) {
+  double s = 0.0;
+  for (size_t i = 0; i < a.size(); i++) s += a[i] * b[i];
+  return s;
+}
+
+struct SolveStats {
+  int iterations;
+  double time, wait_time, rel_residual;
+};
+
+// Standard CG: two blocking MPI_Allreduce per iteration.
+SolveStats cg(const Grid& g, const std::vector<double>& b,
+              std::vector<double>& x, int max_iter, double tol) {
+  size_t m = b.size();
+  std::vector<double> r(m), p(m), q(m);
+  SolveStats st = {0, 0.0, 0.0, 0.0};
+
+  double bb_local = local_dot(b, b), bb;
+  MPI_Allreduce(&bb_local, &bb, 1, MPI_DOUBLE, MPI_SUM, g.comm);
+
+  MPI_Barrier(g.comm);
+  double t0 = MPI_Wtime();
+  apply_A(g, x, q);
+  for (size_t i = 0; i < m; i++) r[i] = b[i] - q[i];
+  p = r;
+  double gamma_local = local_dot(r, r), gamma;
+  MPI_Allreduce(&gamma_local, &gamma, 1, MPI_DOUBLE, MPI_SUM, g.comm);
+
+  int it = 0;
+  while (it < max_iter && sqrt(gamma / bb) > tol) {
+    apply_A(g, p, q);
+    double pq_local = local_dot(p, q), pq;
+    double tw = MPI_Wtime();
+    MPI_Allreduce(&pq_local, &pq, 1, MPI_DOUBLE, MPI_SUM, g.comm);
+    st.wait_time += MPI_Wtime() - tw;
+    double alpha = gamma / pq;
+    for (size_t i = 0; i < m; i++) {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+    }
+    double gamma_new_local = local_dot(r, r), gamma_new;
+    tw = MPI_Wtime();
+    MPI_Allreduce(&gamma_new_local, &gamma_new, 1, MPI_DOUBLE, MPI_SUM,
+                  g.comm);
+    st.wait_time += MPI_Wtime() - tw;
+    double beta = gamma_new / gamma;
+    gamma = gamma_new;
+    for (size_t i = 0; i < m; i++) p[i] = r[i] + beta * p[i];
+    it++;
+  }
+  st.time = MPI_Wtime() - t0;
+  st.iterations = it;
+  return st;
+}
+
+// Pipelined CG (Ghysels & Vanroose, unpreconditioned): one MPI_Iallreduce
+// of {(r, r), (w, r)} per iteration, overlapped with q = A w.
+SolveStats pipelined_cg(const Grid& g, const std::vector<double>& b,
+                        std::vector<double>& x, int max_iter, double tol) {
+  size_t m = b.size();
+  std::vector<double> r(m), w(m), q(m), z(m, 0.0), s(m, 0.0), p(m, 0.0);
+  SolveStats st = {0, 0.0, 0.0, 0.0};
+
+  double bb_local = local_dot(b, b), bb;
+  MPI_Allreduce(&bb_local, &bb, 1, MPI_DOUBLE, MPI_SUM, g.comm);
+
+  MPI_Barrier(g.comm);
+  double t0 = MPI_Wtime();
+  apply_A(g, x, q);
+  for (size_t i = 0; i < m; i++) r[i] = b[i] - q[i];
+  apply_A(g, r, w);
+
+  double gamma_old = 0.0, alpha_old = 0.0;
+  int it = 0;
+  while (it < max_iter) {
+    // 1. Start the reduction of both dot products ...
+    double local[2] = {local_dot(r, r), local_dot(w, r)}, global[2];
+    MPI_Request req;
+    MPI_Iallreduce(local, global, 2, MPI_DOUBLE, MPI_SUM, g.comm, &req);
+
+    // 2. ... and hide it behind the matrix-vector product.
+    apply_A(g, w, q);
+
+    double tw = MPI_Wtime();
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
+    st.wait_time += MPI_Wtime() - tw;
+
+    double gamma = global[0], delta = global[1];
+    if (sqrt(gamma / bb) <= tol) break;
+    double beta, alpha;
+    if (it == 0) {
+      beta = 0.0;
+      alpha = gamma / delta;
+    } else {
+      beta = gamma / gamma_old;
+      alpha = gamma / (delta - beta * gamma / alpha_old);
+    }
+
+    // 3. Recurrences: z = A s, s = A p, w = A r are updated, not computed.
+    for (size_t i = 0; i < m; i++) {
+      z[i] = q[i] + beta * z[i];
+      s[i] = w[i] + beta * s[i];
+      p[i] = r[i] + beta * p[i];
+      x[i] += alpha * p[i];
+      r[i] -= alpha * s[i];
+      w[i] -= alpha * z[i];
+    }
+    gamma_old = gamma;
+    alpha_old = alpha;
+    it++;
+  }
+  st.time = MPI_Wtime() - t0;
+  st.iterations = it;
+  return st;
+}
+
+// ||b - A x|| / ||b|| computed from scratch.
+double true_residual(const Grid& g, const std::vector<double>& b,
+                     const std::vector<double>& x) {
+  std::vector<double> ax(b.size());
+  apply_A(g, x, ax);
+  double local[2] = {0.0, local_dot(b, b)}, global[2];
+  for (size_t i = 0; i < b.size(); i++) {
+    local[0] += (b[i] - ax[i]) * (b[i] - ax[i]);
+  }
+  MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_SUM, g.comm);
+  return sqrt(global[0] / global[1]);
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int n = 512, max_iter = 200;
+  double tol = 1e-8;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) n = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-i") == 0) max_iter = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-t") == 0) tol = atof(argv[i + 1]);
+  }
+
+  // apply_A sends the first and last local row, so every rank needs one.
+  if (n < size) {
+    if (rank == 0) {
+      printf("Error: -n (%d) must be at least the number of processes (%d).\n",
+             n, size);
+    }
+    MPI_Finalize();
+    return 0;
+  }
+
+  std::vector<int> qs;
+  for (int q = 1; q < size; q *= 2) qs.push_back(q);
+  qs.push_back(size);
+
+  if (rank == 0) {
+    printf("[Rank 0] 2D Poisson, %d x %d grid (%d unknowns), max %d "
+           "iterations, tol %.0e\n",
+           n, n, n * n, max_iter, tol);
+    printf("  %5s | %9s %9s %7s %7s | %9s %9s %7s %7s | %s\n", "Ranks",
+           "CG ms/it", "wait ms", "speedup", "eff", "PCG ms/it", "wait ms",
+           "speedup", "eff", "iters, true residual CG / PCG");
+  }
+
+  double base_cg = 0.0, base_pcg = 0.0;
+  bool all_ok = true;
+  for (int q : qs) {
+    MPI_Comm sub;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < q ? 0 : MPI_UNDEFINED, rank, &sub);
+    if (sub != MPI_COMM_NULL) {
+      Grid g = make_grid(n, sub);
+      size_t m = (size_t)g.rows * n;
+      std::vector<double> ones(m, 1.0), b(m);
+      apply_A(g, ones, b);
+
+      // 1. Solve with both methods from x = 0
+      std::vector<double> x_cg(m, 0.0), x_pcg(m, 0.0);
+      SolveStats a = cg(g, b, x_cg, max_iter, tol);
+      SolveStats p = pipelined_cg(g, b, x_pcg, max_iter, tol);
+      a.rel_residual = true_residual(g, b, x_cg);
+      p.rel_residual = true_residual(g, b, x_pcg);
+
+      // 2. Report (max time over ranks)
+      double times[4] = {a.time, a.wait_time, p.time, p.wait_time}, tmax[4];
+      MPI_Reduce(times, tmax, 4, MPI_DOUBLE, MPI_MAX, 0, sub);
+      if (rank == 0) {
+        double cg_it = tmax[0] / std::max(a.iterations, 1);
+        double pcg_it = tmax[2] / std::max(p.iterations, 1);
+        if (q == 1) {
+          base_cg = cg_it;
+          base_pcg = pcg_it;
+        }
+        // 3. Both must reduce the residual, and agree with each other.
+        bool ok = a.rel_residual < 1.0 &&
+                  p.rel_residual < 10.0 * std::max(a.rel_residual, tol);
+        all_ok = all_ok && ok;
+        printf("  %5d | %9.3f %9.3f %7.2f %6.0f%% | %9.3f %9.3f %7.2f "
+               "%6.0f%% | %d, %.2e / %d, %.2e\n",
+               q, cg_it * 1e3, tmax[1] / std::max(a.iterations, 1) * 1e3,
+               base_cg / cg_it, 100.0 * base_cg / cg_it / q, pcg_it * 1e3,
+               tmax[3] / std::max(p.iterations, 1) * 1e3, base_pcg / pcg_it,
+               100.0 * base_pcg / pcg_it / q, a.iterations, a.rel_residual,
+               p.iterations, p.rel_residual);
+      }
+      MPI_Comm_free(&sub);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  if (rank == 0) {
+    printf("[Rank 0] Verification (true residuals decrease and agree): %s\n",
+           all_ok ? "PASS" : "FAIL");
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 pipelined_cg.cpp -o pipelined_cg.bin
+ *
+ * 2. Run:
+ * mpirun -np 4 ./pipelined_cg.bin -n 512 -i 200
+ * mpirun -np 4 --hostfile ../week2/hosts ./pipelined_cg.bin -n 1024
+ *
+ * Observation:
+ * "wait ms" is the time per iteration spent blocked in reductions. For CG
+ * it grows with the rank count (two latency-bound Allreduces); for
+ * pipelined CG most of it is hidden behind the stencil, so PCG keeps a
+ * higher efficiency once the local problem gets small. Both reach about
+ * the same residual; run with -i 2000 to see pipelined CG stall slightly
+ * above CG near machine precision.
+ * ============================================================
+ */
@@ -0,0 +1,468 @@
+/*
+ * File:    sketch_reduce.cpp
+ *
+ * Purpose: Distributed top-k, quantiles and distinct counts with mergeable
+ * sketches as custom MPI_Ops.
+ * reduce_demo.cpp finds the global max with MPI_MAX, but "the 10 slowest
+ * requests", "p99 latency" or "how many distinct users" have no built-in
+ * operation. The exact answer needs all raw data at one rank (gather and
+ * sort), which costs N * 8 bytes of traffic and an O(N log N) sort at the
+ * root.
+ *
+ * A mergeable sketch is a small fixed-size summary with merge(A, B) =
+ * sketch(A union B) (exactly or approximately). Like the accumulator in
+ * repro_reduce.cpp it travels as an opaque block of bytes, and the merge
+ * becomes the MPI_Op, so MPI_Reduce / MPI_Allreduce combine the sketches
+ * along their own reduction tree:
+ * - Top-k:       the k largest (value, rank, index) items; merge = merge
+ *                two sorted lists and keep k. Exact.
+ * - t-digest:    quantiles (Dunning's merging digest) as about DELTA / 2
+ *                (mean, weight) centroids, small near q = 0 and 1 so the
+ *                tails (p99, p99.9) stay accurate; merge = sort the
+ *                centroids of both and recompress. Approximate.
+ * - HyperLogLog: distinct count from 2^HLL_P registers holding the longest
+ *                run of leading zeros of hashed keys; merge = element-wise
+ *                max. Exact merge, ~1.04 / sqrt(2^HLL_P) standard error.
+ *
+ * Scenario:
+ * 1. Every rank holds a slice of a global data set: request latencies
+ *    (log-normal with a heavy tail) and user ids (many repeats).
+ * 2. Sketch path: build the three sketches locally, MPI_Allreduce each one.
+ * 3. Exact path: MPI_Gatherv everything to Rank 0, sort, unique.
+ * 4. Compare accuracy, bytes sent per rank and throughput. Check that
+ *    MPI_Reduce gives the same top-k and HLL as MPI_Allreduce.
+ *
+ * Options:
+ *   -n <N>        Total number of records (default 4000000)
+ *   -s <seed>     Data set seed (default 558)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-03-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+const int TOPK = 10;
+const double DELTA = 200.0;  // t-digest compression
+const int TD_CAP = 256;      // >= DELTA + 1 centroids after compression
+const int HLL_P = 12;
+const int HLL_M = 1 << HLL_P;
+
+// ---------------------------------------------------------------- Top-k
+
+struct TopItem {
+  double value;
+  int rank, index;
+};
+
+// Descending by value; ties broken by (rank, index) so merges are
+// deterministic.
+bool item_before(const TopItem& a, const TopItem& b) {
+  if (a.value != b.value) return a.value > b.value;
+  if (a.rank != b.rank) return a.rank < b.rank;
+  return a.index < b.index;
+}
+
+struct TopK {
+  int count;
+  TopItem item[TOPK];  // Sorted by item_before
+};
+
+// Local top-k with a min-heap of size TOPK (heap top = smallest kept).
+TopK topk_build(const std::vector<double>& x, int rank) {
+  std::priority_queue<TopItem, std::vector<TopItem>,
+                      bool (*)(const TopItem&, const TopItem&)>
+      heap(item_before);
+  for (size_t i = 0; i < x.size(); i++) {
+    TopItem it = {x[i], rank, (int)i};
+    if ((int)heap.size() < TOPK) {
+      heap.push(it);
+    } else if (item_before(it, heap.top())) {
+      heap.pop();
+      heap.push(it);
+    }
+  }
+  TopK t;
+  memset(&t, 0, sizeof(t));
+  t.count = (int)heap.size();
+  for (int i = t.count - 1; i >= 0; i--) {
+    t.item[i] = heap.top();
+    heap.pop();
+  }
+  return t;
+}
+
+void topk_op(void* in, void* inout, int* len, MPI_Datatype*) {
+  TopK* src = (TopK*)in;
+  TopK* dst = (TopK*)inout;
+  for (int k = 0; k < *len; k++) {
+    TopItem merged[2 * TOPK];
+    TopItem* end = std::merge(src[k].item, src[k].item + src[k].count,
+                              dst[k].item, dst[k].item + dst[k].count,
+                              merged, item_before);
+    dst[k].count = std::min(TOPK, (int)(end - merged));
+    std::copy(merged, merged + dst[k].count, dst[k].item);
+  }
+}
+
+// ------------------------------------------------------------- t-digest
+
+struct Centroid {
+  double mean, weight;
+};
+
+struct TDigest {
+  int count;
+  double total, min, max;
+  Centroid c[TD_CAP];  // Sorted by mean
+};
+
+// Scale function k1: centroid size limit shrinks toward q = 0 and q = 1.
+double td_k(double q) { return DELTA / (2.0 * M_PI) * asin(2.0 * q - 1.0); }
+double td_q(double k) {
+  if (k >= DELTA / 4.0) return 1.0;
+  return (sin(k * 2.0 * M_PI / DELTA) + 1.0) / 2.0;
+}
+
+// Greedy merge of sorted centroids: a centroid may grow while it spans at
+// most 1 unit of k. Adjacent output pairs span > 1, so at most DELTA + 1
+// centroids come out.
+void td_compress(const Centroid* in, int n, double total, TDigest& out) {
+  out.count = 0;
+  out.total = total;
+  if (n == 0) return;
+  Centroid cur = in[0];
+  double before = 0.0;  // Weight left of 'cur'
+  double q_limit = td_q(td_k(0.0) + 1.0);
+  for (int i = 1; i < n; i++) {
+    if ((before + cur.weight + in[i].weight) / total <= q_limit) {
+      double w = cur.weight + in[i].weight;
+      cur.mean += (in[i].mean - cur.mean) * in[i].weight / w;
+      cur.weight = w;
+    } else {
+      out.c[out.count++] = cur;
+      before += cur.weight;
+      q_limit = td_q(td_k(before / total) + 1.0);
+      cur = in[i];
+    }
+  }
+  out.c[out.count++] = cur;
+}
+
+// Local digest: every value is a weight-1 centroid.
+TDigest td_build(const std::vector<double>& x) {
+  TDigest t;
+  memset(&t, 0, sizeof(t));
+  t.min = INFINITY;
+  t.max = -INFINITY;
+  std::vector<Centroid> pts(x.size());
+  for (size_t i = 0; i < x.size(); i++) {
+    pts[i] = {x[i], 1.0};
+    t.min = std::min(t.min, x[i]);
+    t.max = std::max(t.max, x[i]);
+  }
+  std::sort(pts.begin(), pts.end(), [](const Centroid& a, const Centroid& b) {
+    return a.mean < b.mean;
+  });
+  td_compress(pts.data(), (int)pts.size(), (double)x.size(), t);
+  return t;
+}
+
+void td_op(void* in, void* inout, int* len, MPI_Datatype*) {
+  TDigest* src = (TDigest*)in;
+  TDigest* dst = (TDigest*)inout;
+  for (int k = 0; k < *len; k++) {
+    Centroid merged[2 * TD_CAP];
+    Centroid* end = std::merge(
+        src[k].c, src[k].c + src[k].count, dst[k].c, dst[k].c + dst[k].count,
+        merged,
+        [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+    dst[k].min = std::min(src[k].min, dst[k].min);
+    dst[k].max = std::max(src[k].max, dst[k].max);
+    td_compress(merged, (int)(end - merged), src[k].total + dst[k].total,
+                dst[k]);
+  }
+}
+
+// Interpolate between centroid centers (and min / max at the ends).
+double td_quantile(const TDigest& t, double q) {
+  if (t.count == 0) return NAN;
+  double target = q * t.total;
+  double center = t.c[0].weight / 2.0;
+  if (target <= center) {
+    return t.min + (t.c[0].mean - t.min) * (center > 0 ? target / center : 0);
+  }
+  double before = 0.0;
+  for (int i = 0; i + 1 < t.count; i++) {
+    double c0 = before + t.c[i].weight / 2.0;
+    double c1 = before + t.c[i].weight + t.c[i + 1].weight / 2.0;
+    if (target <= c1) {
+      return t.c[i].mean +
+             (t.c[i + 1].mean - t.c[i].mean) * (target - c0) / (c1 - c0);
+    }
+    before += t.c[i].weight;
+  }
+  const Centroid& last = t.c[t.count - 1];
+  double c_last = t.total - last.weight / 2.0;
+  return last.mean +
+         (t.max - last.mean) * (target - c_last) / (t.total - c_last);
+}
+
+// ---------------------------------------------------------- HyperLogLog
+
+struct HLL {
+  uint8_t reg[HLL_M];
+};
+
+// splitmix64 finalizer: a cheap, well-mixed 64-bit hash.
+inline uint64_t mix64(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+HLL hll_build(const std::vector<uint64_t>& keys) {
+  HLL h;
+  memset(&h, 0, sizeof(h));
+  for (uint64_t key : keys) {
+    uint64_t x = mix64(key);
+    int idx = (int)(x >> (64 - HLL_P));
+    // Leading zeros of the remaining bits + 1, capped at 64 - HLL_P + 1.
+    uint64_t w = (x << HLL_P) | (1ULL << (HLL_P - 1));
+    uint8_t rho = (uint8_t)(__builtin_clzll(w) + 1);
+    if (rho > h.reg[idx]) h.reg[idx] = rho;
+  }
+  return h;
+}
+
+void hll_op(void* in, void* inout, int* len, MPI_Datatype*) {
+  HLL* src = (HLL*)in;
+  HLL* dst = (HLL*)inout;
+  for (int k = 0; k < *len; k++) {
+    for (int i = 0; i < HLL_M; i++) {
+      dst[k].reg[i] = std::max(dst[k].reg[i], src[k].reg[i]);
+    }
+  }
+}
+
+// Harmonic-mean estimate with the linear-counting correction for small
+// cardinalities (Flajolet et al., 2007).
+double hll_estimate(const HLL& h) {
+  double sum = 0.0;
+  int zeros = 0;
+  for (int i = 0; i < HLL_M; i++) {
+    sum += ldexp(1.0, -h.reg[i]);
+    if (h.reg[i] == 0) zeros++;
+  }
+  double alpha = 0.7213 / (1.0 + 1.079 / HLL_M);
+  double e = alpha * HLL_M * HLL_M / sum;
+  if (e <= 2.5 * HLL_M && zeros > 0) e = HLL_M * log((double)HLL_M / zeros);
+  return e;
+}
+
+// ------------------------------------------------------------------ Data
+
+// Record g of the global data set, independent of the decomposition.
+// Latency in ms: log-normal around 2 ms, 1% of requests 10x slower.
+double record_latency(uint64_t seed, long g) {
+  uint64_t a = mix64(seed ^ (2 * (uint64_t)g));
+  uint64_t b = mix64(seed ^ (2 * (uint64_t)g + 1));
+  double u1 = ((a >> 11) + 1.0) * 0x1.0p-53;
+  double u2 = (b >> 11) * 0x1.0p-53;
+  double z = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+  double ms = 2.0 * exp(0.5 * z);
+  return (b & 127) < 1 ? ms * 10.0 : ms;
+}
+
+// User id: N / 2 possible users, so most appear more than once.
+uint64_t record_user(uint64_t seed, long g, long n) {
+  return mix64(~seed ^ (uint64_t)g) % (uint64_t)std::max(1L, n / 2);
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  long n = 4000000;
+  uint64_t seed = 558;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) n = atol(argv[i + 1]);
+    if (strcmp(argv[i], "-s") == 0) seed = strtoull(argv[i + 1], NULL, 0);
+  }
+
+  // 1. Local slice (same block distribution as vector_multiply_irregular)
+  long base = n / size, rem = n % size;
+  long my_count = base + (rank < rem ? 1 : 0);
+  long start = rank * base + std::min((long)rank, rem);
+  std::vector<double> latency(my_count);
+  std::vector<uint64_t> user(my_count);
+  for (long i = 0; i < my_count; i++) {
+    latency[i] = record_latency(seed, start + i);
+    user[i] = record_user(seed, start + i, n);
+  }
+
+  // 2. Register the sketch types and merge operations. Top-k and HLL merges
+  // are exactly commutative; the t-digest merge is up to rounding, which
+  // does not matter for an approximate sketch.
+  MPI_Datatype topk_type, td_type, hll_type;
+  MPI_Type_contiguous(sizeof(TopK), MPI_BYTE, &topk_type);
+  MPI_Type_contiguous(sizeof(TDigest), MPI_BYTE, &td_type);
+  MPI_Type_contiguous(sizeof(HLL), MPI_BYTE, &hll_type);
+  MPI_Type_commit(&topk_type);
+  MPI_Type_commit(&td_type);
+  MPI_Type_commit(&hll_type);
+  MPI_Op topk_merge, td_merge, hll_merge;
+  MPI_Op_create(topk_op, 1, &topk_merge);
+  MPI_Op_create(td_op, 1, &td_merge);
+  MPI_Op_create(hll_op, 1, &hll_merge);
+
+  // 3. Sketch path: build locally, Allreduce (every rank gets the answer)
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t0 = MPI_Wtime();
+  TopK top_local = topk_build(latency, rank), top;
+  TDigest td_local = td_build(latency), td;
+  HLL hll_local = hll_build(user), hll;
+  MPI_Allreduce(&top_local, &top, 1, topk_type, topk_merge, MPI_COMM_WORLD);
+  MPI_Allreduce(&td_local, &td, 1, td_type, td_merge, MPI_COMM_WORLD);
+  MPI_Allreduce(&hll_local, &hll, 1, hll_type, hll_merge, MPI_COMM_WORLD);
+  double t_sketch = MPI_Wtime() - t0, t_sketch_max;
+  MPI_Reduce(&t_sketch, &t_sketch_max, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  // The same sketches with MPI_Reduce: exact merges must agree bitwise.
+  TopK top_root;
+  HLL hll_root;
+  MPI_Reduce(&top_local, &top_root, 1, topk_type, topk_merge, 0,
+             MPI_COMM_WORLD);
+  MPI_Reduce(&hll_local, &hll_root, 1, hll_type, hll_merge, 0,
+             MPI_COMM_WORLD);
+
+  // 4. Exact path: gather raw records at Rank 0, sort, unique
+  std::vector<int> counts(size), displs(size);
+  int my_int = (int)my_count;
+  MPI_Barrier(MPI_COMM_WORLD);
+  t0 = MPI_Wtime();
+  MPI_Gather(&my_int, 1, MPI_INT, counts.data(), 1, MPI_INT, 0,
+             MPI_COMM_WORLD);
+  std::vector<double> all_latency;
+  std::vector<uint64_t> all_user;
+  if (rank == 0) {
+    for (int r = 1; r < size; r++) displs[r] = displs[r - 1] + counts[r - 1];
+    all_latency.resize(n);
+    all_user.resize(n);
+  }
+  MPI_Gatherv(latency.data(), my_int, MPI_DOUBLE, all_latency.data(),
+              counts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  MPI_Gatherv(user.data(), my_int, MPI_UINT64_T, all_user.data(),
+              counts.data(), displs.data(), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+  long exact_distinct = 0;
+  if (rank == 0) {
+    std::sort(all_latency.begin(), all_latency.end());
+    std::sort(all_user.begin(), all_user.end());
+    exact_distinct =
+        std::unique(all_user.begin(), all_user.end()) - all_user.begin();
+  }
+  double t_exact = MPI_Wtime() - t0;
+
+  // 5. Report (Rank 0)
+  if (rank == 0) {
+    printf("[Rank 0] %ld records on %d ranks (%ld..%ld per rank)\n", n, size,
+           base, base + (rem ? 1 : 0));
+
+    bool top_ok = top.count == std::min<long>(TOPK, n);
+    for (int i = 0; i < top.count && top_ok; i++) {
+      top_ok = top.item[i].value == all_latency[n - 1 - i];
+    }
+    printf("[Rank 0] Top-%d latencies (ms):", TOPK);
+    for (int i = 0; i < top.count; i++) {
+      printf(" %.1f@%d", top.item[i].value, top.item[i].rank);
+    }
+    printf("\n[Rank 0] Top-%d matches the exact sort: %s\n", TOPK,
+           top_ok ? "PASS" : "FAIL");
+
+    printf("[Rank 0] t-digest: %d centroids\n", td.count);
+    printf("  %8s %12s %12s %10s %12s\n", "Quantile", "Exact (ms)",
+           "Sketch (ms)", "Rel. err", "Rank err");
+    const double QS[] = {0.5, 0.9, 0.99, 0.999};
+    double worst_rank_err = 0.0;
+    for (double q : QS) {
+      double exact = all_latency[(long)(q * (n - 1))];
+      double est = td_quantile(td, q);
+      double below = std::lower_bound(all_latency.begin(), all_latency.end(),
+                                      est) - all_latency.begin();
+      double rank_err = fabs(below / n - q);
+      worst_rank_err = std::max(worst_rank_err, rank_err);
+      printf("  %8.3f %12.4f %12.4f %9.3f%% %12.2e\n", q, exact, est,
+             100.0 * fabs(est - exact) / exact, rank_err);
+    }
+
+    double est_distinct = hll_estimate(hll);
+    double hll_err = fabs(est_distinct - exact_distinct) / exact_distinct;
+    double hll_sigma = 1.04 / sqrt((double)HLL_M);
+    printf("[Rank 0] Distinct users: exact %ld, HLL %.0f (%.2f%% error, "
+           "sigma %.2f%%)\n",
+           exact_distinct, est_distinct, 100.0 * hll_err, 100.0 * hll_sigma);
+
+    bool reduce_ok = memcmp(&top_root, &top, sizeof(top)) == 0 &&
+                     memcmp(&hll_root, &hll, sizeof(hll)) == 0;
+    bool ok = top_ok && worst_rank_err < 0.01 && hll_err < 4.0 * hll_sigma &&
+              reduce_ok;
+    printf("[Rank 0] MPI_Reduce == MPI_Allreduce for top-k and HLL: %s\n",
+           reduce_ok ? "PASS" : "FAIL");
+
+    printf("--------------------------------\n");
+    size_t sketch_bytes = sizeof(TopK) + sizeof(TDigest) + sizeof(HLL);
+    size_t exact_bytes = (size_t)my_count * (sizeof(double) + sizeof(uint64_t));
+    printf("[Rank 0] Sketch: %8.3f ms  (%.1f Mrec/s), %zu bytes per rank\n",
+           t_sketch_max * 1e3, n / t_sketch_max / 1e6, sketch_bytes);
+    printf("[Rank 0] Exact:  %8.3f ms  (%.1f Mrec/s), %zu bytes per rank "
+           "(answer at Rank 0 only)\n",
+           t_exact * 1e3, n / t_exact / 1e6, exact_bytes);
+    printf("[Rank 0] Verification (top-k exact, quantile rank error < 1%%, "
+           "HLL within 4 sigma): %s\n",
+           ok ? "PASS" : "FAIL");
+  }
+
+  MPI_Op_free(&topk_merge);
+  MPI_Op_free(&td_merge);
+  MPI_Op_free(&hll_merge);
+  MPI_Type_free(&topk_type);
+  MPI_Type_free(&td_type);
+  MPI_Type_free(&hll_type);
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 sketch_reduce.cpp -o sketch_reduce.bin
+ *
+ * 2. Run:
+ * mpirun -np 4 ./sketch_reduce.bin -n 4000000
+ * mpirun -np 8 --hostfile ../week2/hosts ./sketch_reduce.bin -n 40000000
+ *
+ * Observation:
+ * The sketches send a few KB per rank no matter how large N is, while the
+ * exact path sends 16 bytes per record and serializes the sort at Rank 0.
+ * Top-k is exact; the t-digest is most accurate in the tails, where the
+ * rank error of p99.9 is far below that of the median; the HLL error stays
+ * around 1.6% for any N.
+ * ============================================================
+ */
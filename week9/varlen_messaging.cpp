@@ -0,0 +1,458 @@
+/*
+ * File:    varlen_messaging.cpp
+ *
+ * Purpose: Variable-length records with matched probe and pooled buffers.
+ * Every other program in this course sends fixed-count MPI_INT arrays whose
+ * size both sides know in advance. Real records are variable-length
+ * (strings, vectors, serialized structs). The usual workaround costs twice:
+ * - a separate message carrying the size, so the receiver can allocate
+ *   (an extra latency per message), and
+ * - serializing into a temporary std::vector and copying it into the send
+ *   buffer (an extra pass over every byte).
+ *
+ * This program does it in one message and one pass:
+ * - The sender computes the exact encoded size of the batch, takes a buffer
+ *   of that size class from a pool, and the Writer encodes straight into
+ *   it. That buffer is what MPI_Isend sends.
+ * - The receiver calls MPI_Improbe(MPI_ANY_SOURCE) to learn the size from
+ *   the message envelope (MPI_Get_count), takes a right-sized buffer from
+ *   the pool and calls MPI_Mrecv. The matched probe removes the message
+ *   from the matching queue, so no other receive (or thread) can steal it
+ *   between the probe and the receive, which plain MPI_Probe +
+ *   MPI_Recv(ANY_SOURCE) cannot guarantee.
+ * - Buffers go back to the pool (power-of-two size classes), so a steady
+ *   stream of messages does not call malloc at all.
+ *
+ * Wire format of one message (little-endian, no padding):
+ *   u32 src, u32 seq, u32 nrec, then nrec records of
+ *   u64 id, i32 level, str host, str text, u32 n + n * f64 metrics
+ *   where str = u32 length + bytes.
+ *
+ * Scenario:
+ * 1. Every rank sends -m messages (random record count and lengths, some
+ *    up to ~1 MB) to pseudo-random destinations. Expected counts per
+ *    destination come from MPI_Reduce_scatter_block.
+ * 2. Baseline: staging vector + copy, size message + payload message.
+ * 3. Pooled: exact-size encode into pooled buffer, Improbe + Mrecv.
+ * 4. Every received record is checked against its regenerated original.
+ *
+ * Options:
+ *   -m <M>        Messages per rank (default 2000)
+ *   -r <R>        Maximum records per message (default 32)
+ *   -s <S>        Maximum string length (default 200)
+ *
+ * Author:  dzhao@uw.edu
+ * Date:    2026-03-02
+ * Course:  TCSS 558
+ */
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const int TAG_SIZE = 1;
+const int TAG_DATA = 2;
+const int WINDOW = 16;     // Outstanding sends per rank
+const int MIN_CLASS = 8;   // Smallest pooled buffer: 256 B
+const int MAX_CLASS = 24;  // Largest pooled buffer: 16 MiB
+
+// ------------------------------------------------------------ Buffer pool
+
+struct PoolBuffer {
+  char* data;
+  size_t size;  // Bytes in use
+  int cls;      // Size class (capacity 2^cls), -1 = not pooled
+};
+
+// Free lists of power-of-two buffers. Not thread-safe: one pool per thread.
+class BufferPool {
+ public:
+  BufferPool() : free_(MAX_CLASS + 1), hits_(0), misses_(0) {}
+  ~BufferPool() {
+    for (auto& list : free_) {
+      for (char* p : list) free(p);
+    }
+  }
+
+  PoolBuffer acquire(size_t size) {
+    int cls = MIN_CLASS;
+    while (cls <= MAX_CLASS && ((size_t)1 << cls) < size) cls++;
+    if (cls > MAX_CLASS) {
+      misses_++;
+      return {(char*)malloc(size), size, -1};
+    }
+    if (!free_[cls].empty()) {
+      hits_++;
+      char* p = free_[cls].back();
+      free_[cls].pop_back();
+      return {p, size, cls};
+    }
+    misses_++;
+    return {(char*)malloc((size_t)1 << cls), size, cls};
+  }
+
+  void release(PoolBuffer& b) {
+    if (b.cls < 0) {
+      free(b.data);
+    } else {
+      free_[b.cls].push_back(b.data);
+    }
+    b.data = nullptr;
+  }
+
+  long hits() const { return hits_; }
+  long misses() const { return misses_; }
+
+ private:
+  std::vector<std::vector<char*>> free_;
+  long hits_, misses_;
+};
+
+// ------------------------------------------------------------ Records
+
+struct LogRecord {
+  uint64_t id;
+  int32_t level;
+  std::string host, text;
+  std::vector<double> metrics;
+};
+
+inline uint64_t mix64(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Message 'seq' of rank 'src' is fully determined by (src, seq), so the
+// receiver can regenerate and check it.
+uint64_t message_key(int src, int seq) {
+  return mix64(((uint64_t)src << 32) | (uint32_t)seq);
+}
+
+int message_records(int src, int seq, int max_records) {
+  return 1 + (int)(message_key(src, seq) % (uint64_t)max_records);
+}
+
+// About 1 message in 100 carries one huge text field (~1 MB).
+LogRecord make_record(int src, int seq, int i, int max_str) {
+  uint64_t h = mix64(message_key(src, seq) + (uint64_t)i);
+  LogRecord r;
+  r.id = h;
+  r.level = (int32_t)(h % 5);
+  r.host = "node" + std::to_string((h >> 8) % 64);
+  size_t len = (h >> 16) % (uint64_t)(max_str + 1);
+  if (i == 0 && (h >> 40) % 100 == 0) len = (1 << 20) + (h % 4096);
+  r.text.resize(len);
+  for (size_t k = 0; k < len; k++) r.text[k] = (char)('a' + (h + k) % 26);
+  r.metrics.resize((h >> 24) % 8);
+  for (size_t k = 0; k < r.metrics.size(); k++) {
+    r.metrics[k] = (double)(h % 997) + k;
+  }
+  return r;
+}
+
+size_t encoded_size(const LogRecord& r) {
+  return sizeof(uint64_t) + sizeof(int32_t) + 4 + r.host.size() + 4 +
+         r.text.size() + 4 + r.metrics.size() * sizeof(double);
+}
+
+// Appends values to a caller-provided buffer (no allocation, no staging).
+class Writer {
+ public:
+  explicit Writer(char* p) : p_(p) {}
+  template <typename T>
+  void put(T v) {
+    memcpy(p_, &v, sizeof(T));
+    p_ += sizeof(T);
+  }
+  void put_bytes(const void* src, uint32_t n) {
+    put<uint32_t>(n);
+    memcpy(p_, src, n);
+    p_ += n;
+  }
+  void put(const LogRecord& r) {
+    put<uint64_t>(r.id);
+    put<int32_t>(r.level);
+    put_bytes(r.host.data(), (uint32_t)r.host.size());
+    put_bytes(r.text.data(), (uint32_t)r.text.size());
+    put_bytes(r.metrics.data(),
+              (uint32_t)(r.metrics.size() * sizeof(double)));
+  }
+
+ private:
+  char* p_;
+};
+
+// Bounds-checked decoding; ok() turns false on truncated input.
+class Reader {
+ public:
+  Reader(const char* p, size_t n) : p_(p), end_(p + n), ok_(true) {}
+  template <typename T>
+  T get() {
+    T v = T();
+    if (!take(sizeof(T))) return v;
+    memcpy(&v, p_ - sizeof(T), sizeof(T));
+    return v;
+  }
+  const char* get_bytes(uint32_t* n) {
+    *n = get<uint32_t>();
+    return take(*n) ? p_ - *n : nullptr;
+  }
+  bool get(LogRecord& r) {
+    uint32_t n;
+    r.id = get<uint64_t>();
+    r.level = get<int32_t>();
+    const char* s = get_bytes(&n);
+    if (s) r.host.assign(s, n);
+    s = get_bytes(&n);
+    if (s) r.text.assign(s, n);
+    s = get_bytes(&n);
+    if (s) {
+      r.metrics.resize(n / sizeof(double));
+      memcpy(r.metrics.data(), s, r.metrics.size() * sizeof(double));
+    }
+    return ok_;
+  }
+  bool ok() const { return ok_ && p_ == end_; }
+
+ private:
+  bool take(size_t n) {
+    if (!ok_ || (size_t)(end_ - p_) < n) return ok_ = false;
+    p_ += n;
+    return true;
+  }
+  const char* p_;
+  const char* end_;
+  bool ok_;
+};
+
+bool same(const LogRecord& a, const LogRecord& b) {
+  return a.id == b.id && a.level == b.level && a.host == b.host &&
+         a.text == b.text && a.metrics == b.metrics;
+}
+
+// Decode one message and compare with the regenerated original.
+bool check_message(const char* p, size_t n, int max_records, int max_str) {
+  Reader rd(p, n);
+  int src = (int)rd.get<uint32_t>();
+  int seq = (int)rd.get<uint32_t>();
+  int nrec = (int)rd.get<uint32_t>();
+  if (nrec != message_records(src, seq, max_records)) return false;
+  bool ok = true;
+  for (int i = 0; i < nrec && ok; i++) {
+    LogRecord r;
+    ok = rd.get(r) && same(r, make_record(src, seq, i, max_str));
+  }
+  return ok && rd.ok();
+}
+
+// ------------------------------------------------------------ Exchange
+
+struct RunStats {
+  long messages, bytes, copied, bad;
+  double time;
+};
+
+int destination(int src, int seq, int size) {
+  return (int)(mix64(message_key(src, seq) ^ 0x5555) % (uint64_t)size);
+}
+
+// Send my messages and receive 'expected' ones, never blocking on one side
+// only (large sends are rendezvous and need the peer to be receiving).
+RunStats run(bool pooled, int rank, int size, int msgs, int expected,
+             int max_records, int max_str, BufferPool& pool) {
+  RunStats st = {0, 0, 0, 0, 0.0};
+  std::vector<MPI_Request> reqs(WINDOW, MPI_REQUEST_NULL);
+  std::vector<PoolBuffer> bufs(WINDOW, PoolBuffer{nullptr, 0, -1});
+  std::vector<std::vector<char>> staging(WINDOW);
+  std::vector<int> sizes(WINDOW);
+  int sent = 0, received = 0;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double t0 = MPI_Wtime();
+  while (sent < msgs || received < expected) {
+    // 1. Fill a free send slot
+    int slot = -1;
+    if (sent < msgs) {
+      int idx, flag;
+      MPI_Testany(WINDOW, reqs.data(), &idx, &flag, MPI_STATUS_IGNORE);
+      for (int k = 0; k < WINDOW && slot < 0; k++) {
+        if (reqs[k] == MPI_REQUEST_NULL) slot = k;
+      }
+    }
+    if (slot >= 0) {
+      if (bufs[slot].data) pool.release(bufs[slot]);
+      int nrec = message_records(rank, sent, max_records);
+      std::vector<LogRecord> recs;
+      for (int i = 0; i < nrec; i++) {
+        recs.push_back(make_record(rank, sent, i, max_str));
+      }
+      int dst = destination(rank, sent, size);
+      size_t n = 3 * sizeof(uint32_t);
+      for (const LogRecord& r : recs) n += encoded_size(r);
+
+      if (pooled) {
+        // Encode straight into the buffer that MPI sends.
+        bufs[slot] = pool.acquire(n);
+        Writer w(bufs[slot].data);
+        w.put<uint32_t>(rank);
+        w.put<uint32_t>(sent);
+        w.put<uint32_t>(nrec);
+        for (const LogRecord& r : recs) w.put(r);
+        MPI_Isend(bufs[slot].data, (int)n, MPI_BYTE, dst, TAG_DATA,
+                  MPI_COMM_WORLD, &reqs[slot]);
+      } else {
+        // Baseline: serialize into a growing vector, copy into the send
+        // buffer, announce the size with a message of its own.
+        std::vector<char> tmp;
+        auto append = [&tmp](const void* p, size_t k) {
+          tmp.insert(tmp.end(), (const char*)p, (const char*)p + k);
+        };
+        uint32_t head[3] = {(uint32_t)rank, (uint32_t)sent, (uint32_t)nrec};
+        append(head, sizeof(head));
+        for (const LogRecord& r : recs) {
+          std::vector<char> one(encoded_size(r));
+          Writer w(one.data());
+          w.put(r);
+          append(one.data(), one.size());
+        }
+        staging[slot].assign(tmp.begin(), tmp.end());
+        st.copied += (long)tmp.size();
+        sizes[slot] = (int)tmp.size();
+        MPI_Send(&sizes[slot], 1, MPI_INT, dst, TAG_SIZE, MPI_COMM_WORLD);
+        MPI_Isend(staging[slot].data(), sizes[slot], MPI_BYTE, dst, TAG_DATA,
+                  MPI_COMM_WORLD, &reqs[slot]);
+      }
+      st.bytes += (long)n;
+      sent++;
+    }
+
+    // 2. Receive whatever has arrived
+    if (received < expected) {
+      int flag;
+      MPI_Status status;
+      if (pooled) {
+        MPI_Message msg;
+        MPI_Improbe(MPI_ANY_SOURCE, TAG_DATA, MPI_COMM_WORLD, &flag, &msg,
+                    &status);
+        if (flag) {
+          int count;
+          MPI_Get_count(&status, MPI_BYTE, &count);
+          PoolBuffer b = pool.acquire(count);
+          MPI_Mrecv(b.data, count, MPI_BYTE, &msg, MPI_STATUS_IGNORE);
+          if (!check_message(b.data, count, max_records, max_str)) st.bad++;
+          pool.release(b);
+          received++;
+        }
+      } else {
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_SIZE, MPI_COMM_WORLD, &flag, &status);
+        if (flag) {
+          int count;
+          MPI_Recv(&count, 1, MPI_INT, status.MPI_SOURCE, TAG_SIZE,
+                   MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+          std::vector<char> b(count);
+          MPI_Recv(b.data(), count, MPI_BYTE, status.MPI_SOURCE, TAG_DATA,
+                   MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+          if (!check_message(b.data(), count, max_records, max_str)) st.bad++;
+          received++;
+        }
+      }
+    }
+  }
+  MPI_Waitall(WINDOW, reqs.data(), MPI_STATUSES_IGNORE);
+  for (PoolBuffer& b : bufs) {
+    if (b.data) pool.release(b);
+  }
+  st.time = MPI_Wtime() - t0;
+  st.messages = received;
+  return st;
+}
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int msgs = 2000, max_records = 32, max_str = 200;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-m") == 0) msgs = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-r") == 0) max_records = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-s") == 0) max_str = atoi(argv[i + 1]);
+  }
+
+  // 1. How many messages will I receive? Sum of everyone's per-destination
+  // counts, scattered so each rank gets its own entry.
+  std::vector<int> per_dest(size, 0);
+  for (int s = 0; s < msgs; s++) per_dest[destination(rank, s, size)]++;
+  int expected;
+  MPI_Reduce_scatter_block(per_dest.data(), &expected, 1, MPI_INT, MPI_SUM,
+                           MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    printf("[Rank 0] %d ranks x %d messages, 1..%d records each, strings "
+           "up to %d bytes\n",
+           size, msgs, max_records, max_str);
+    printf("  %-22s %10s %10s %10s %12s %8s\n", "Method", "Time (s)",
+           "Msgs/s", "MB/s", "Copied (MB)", "Errors");
+  }
+
+  // 2. Baseline, then pooled + matched probe
+  BufferPool pool;
+  const char* names[] = {"size msg + staging", "pooled + Mprobe/Mrecv"};
+  long total_bad = 0;
+  for (int pooled = 0; pooled <= 1; pooled++) {
+    RunStats st =
+        run(pooled, rank, size, msgs, expected, max_records, max_str, pool);
+    long sums[4] = {st.messages, st.bytes, st.copied, st.bad}, tot[4];
+    MPI_Reduce(sums, tot, 4, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    double tmax;
+    MPI_Reduce(&st.time, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+      printf("  %-22s %10.3f %10.0f %10.1f %12.1f %8ld\n", names[pooled], tmax,
+             tot[0] / tmax, tot[1] / 1e6 / tmax, tot[2] / 1e6, tot[3]);
+      total_bad += tot[3] + (tot[0] != (long)size * msgs);
+    }
+  }
+
+  // 3. Pool effectiveness (second run reuses the buffers of the first)
+  long pool_stats[2] = {pool.hits(), pool.misses()}, pool_tot[2];
+  MPI_Reduce(pool_stats, pool_tot, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (rank == 0) {
+    printf("[Rank 0] Pool: %ld hits, %ld mallocs (%.1f%% reuse)\n",
+           pool_tot[0], pool_tot[1],
+           100.0 * pool_tot[0] / std::max(1L, pool_tot[0] + pool_tot[1]));
+    printf("[Rank 0] Verification (every record decoded and identical): %s\n",
+           total_bad == 0 ? "PASS" : "FAIL");
+  }
+
+  MPI_Finalize();
+  return 0;
+}
+
+/*
+ * ============================================================
+ * Compile & Run Instructions:
+ * ============================================================
+ * 1. Compile:
+ * mpic++ -O2 varlen_messaging.cpp -o varlen_messaging.bin
+ *
+ * 2. Run:
+ * mpirun -np 4 ./varlen_messaging.bin -m 2000
+ * mpirun -np 4 ./varlen_messaging.bin -m 20000 -r 4 -s 32   (small msgs)
+ *
+ * Observation:
+ * The pooled path sends half as many messages and copies nothing outside
+ * MPI. Small messages gain the most (the size message is a full extra
+ * latency); for the ~1 MB messages the bandwidth is the same and only the
+ * staging copy is saved. After warm-up almost every buffer comes from the
+ * pool.
+ * ============================================================
+ */